@@ -0,0 +1,364 @@
+#include "ai.h"
+
+#include <atomic>
+
+#include "field_features.h"
+#include "trace.h"
+
+typedef std::chrono::steady_clock Clock;
+
+const double SCORE_GAME_OVER = -1e9;
+
+/* The placements of a piece are summarized per rotation step by the column
+ * the piece got rotated in and how far it could be shifted to both sides,
+ * 5 bits each stored as x + 8 (0 for a rotation step that was skipped).
+ * The summary fits a transposition table payload */
+const unsigned int REACH_BITS = 15;
+const int REACH_OFFSET = 8;
+
+static uint64_t reachStep(int start, int left, int right){
+    return static_cast<uint64_t>(start + REACH_OFFSET)
+        | static_cast<uint64_t>(left + REACH_OFFSET) << 5
+        | static_cast<uint64_t>(right + REACH_OFFSET) << 10;
+}
+
+static bool sameRotation(unsigned char shape, unsigned char a, unsigned char b){
+    const ShapeInfo& info = TETROMINO_TABLE[shape];
+    for (unsigned char r = 0; r < info.size; r++)
+        if (info.rows[a][r] != info.rows[b][r])
+            return false;
+
+    return true;
+}
+
+static uint64_t findReach(const Field& field, const Tetromino& tetromino){
+    /* Rotates the piece 0-3 times at its current position, then shifts
+     * it as far as it goes to both sides */
+    uint64_t reach = 0;
+
+    if (collidesWith(tetromino, field))
+        return 0;
+
+    Tetromino rotated = tetromino;
+    for (unsigned char nRotations = 0; nRotations < 4; nRotations++){
+        if (nRotations > 0 && !rotate(rotated, field))
+            break;
+
+        // Symmetric shapes repeat their rotations, skip the duplicates
+        bool duplicate = false;
+        Tetromino check = tetromino;
+        for (unsigned char i = 0; i < nRotations && !duplicate; i++){
+            duplicate = sameRotation(tetromino.shape, check.rotation, rotated.rotation);
+            check.rotation = (check.rotation + 1) & 3;
+        }
+        if (duplicate)
+            continue;
+
+        Tetromino left = rotated;
+        while (move(left, field, DIR_LEFT));
+        Tetromino right = rotated;
+        while (move(right, field, DIR_RIGHT));
+
+        reach |= reachStep(rotated.x, left.x, right.x) << (nRotations * REACH_BITS);
+    }
+
+    return reach;
+}
+
+static unsigned int expandReach(const Field& field, const Tetromino& tetromino, uint64_t reach, Placement* placements){
+    /* Hard drops the piece from every reachable column, each rotation from
+     * where it was rotated first, then to the left and then to the right.
+     * Every (rotation, column) pair comes up once */
+    unsigned int nPlacements = 0;
+
+    for (unsigned char nRotations = 0; nRotations < 4; nRotations++){
+        uint64_t step = (reach >> (nRotations * REACH_BITS)) & ((1u << REACH_BITS) - 1);
+        if (step == 0)
+            continue;
+
+        int start = static_cast<int>(step & 31) - REACH_OFFSET;
+        int left = static_cast<int>((step >> 5) & 31) - REACH_OFFSET;
+        int right = static_cast<int>(step >> 10) - REACH_OFFSET;
+
+        Tetromino dropped = tetromino;
+        dropped.rotation = (tetromino.rotation + nRotations) & 3;
+        for (int i = 0; i <= right - left; i++){
+            // start, start - 1 ... left, start + 1 ... right
+            dropped.x = i <= start - left ? start - i : left + i;
+            dropped.y = tetromino.y;
+            dropped.y = dropRow(dropped, field);
+
+            Placement& p = placements[nPlacements++];
+            p.valid = true;
+            p.rotation = dropped.rotation;
+            p.x = dropped.x;
+            p.y = dropped.y;
+            p.score = 0;
+        }
+    }
+
+    return nPlacements;
+}
+
+unsigned int enumeratePlacements(const Field& field, const Tetromino& tetromino, Placement* placements){
+    /* Every placement reached by rotating the piece at its current position,
+     * shifting it and dropping it. Returns the number of placements written */
+    return expandReach(field, tetromino, findReach(field, tetromino), placements);
+}
+
+static double scoreFeatures(unsigned int aggregateHeight, unsigned int holes, unsigned int bumpiness,
+        unsigned char linesCleared, const HeuristicWeights& weights){
+    return weights.aggregateHeight * aggregateHeight
+        + weights.linesCleared * linesCleared
+        + weights.holes * holes
+        + weights.bumpiness * bumpiness;
+}
+
+double evaluateField(const Field& field, unsigned char linesCleared, const HeuristicWeights& weights){
+    /* Scores a field by aggregate height, holes, bumpiness and lines cleared */
+    FieldFeatures features = computeFieldFeatures(field);
+    return scoreFeatures(features.aggregateHeight, features.holes, features.bumpiness, linesCleared, weights);
+}
+
+// Tell the two kinds of table entries apart, a field key alone is the evaluation
+const uint64_t REACH_KEY = 0x7E1A5CE0F00Dull;
+
+// Shared by every node one search task visits
+struct SearchContext {
+    const HeuristicWeights* weights;
+    Clock::time_point deadline;
+    std::atomic<bool>* timedOut;
+
+    TranspositionTable* cache;  // NULL searches without one
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+static unsigned int cachedPlacements(const Field& field, uint64_t fieldKey, const Tetromino& tetromino,
+        Placement* placements, SearchContext& context){
+    // Placements of the piece, with the reachability summary from the cache when this state was seen before
+    if (context.cache == NULL)
+        return enumeratePlacements(field, tetromino, placements);
+
+    uint64_t key = fieldKey ^ zobristPieceKey(tetromino) ^ REACH_KEY;
+    uint64_t reach;
+    if (context.cache->probe(key, reach))
+        context.hits++;
+    else{
+        context.misses++;
+        reach = findReach(field, tetromino);
+        context.cache->store(key, reach);
+    }
+
+    return expandReach(field, tetromino, reach, placements);
+}
+
+static double cachedEvaluation(const Field& field, uint64_t fieldKey, unsigned char linesCleared, SearchContext& context){
+    // The lines cleared on the way differ, only the features of the field are cached
+    if (context.cache == NULL)
+        return evaluateField(field, linesCleared, *context.weights);
+
+    uint64_t features;
+    if (context.cache->probe(fieldKey, features))
+        context.hits++;
+    else{
+        context.misses++;
+        FieldFeatures computed = computeFieldFeatures(field);
+        features = computed.aggregateHeight | computed.holes << 16 | static_cast<uint64_t>(computed.bumpiness) << 32;
+        context.cache->store(fieldKey, features);
+    }
+
+    return scoreFeatures(features & 0xFFFF, (features >> 16) & 0xFFFF, features >> 32, linesCleared, *context.weights);
+}
+
+static double searchPlacement(const Field& field, uint64_t fieldKey, const Placement& placement, unsigned char shape,
+        const unsigned char* preview, unsigned int depth, unsigned int totalLines, SearchContext& context){
+    /* Locks the piece at the placement, then searches the best placement
+     * of the following preview pieces. Returns the score of the best leaf */
+    Field child = field;
+    Tetromino tetromino = { placement.x, placement.y, true, shape, placement.rotation };
+    freezeTetromino(tetromino, child);
+    uint64_t clearedRows;
+    unsigned char lines = flushFull(tetromino, child, clearedRows);
+    totalLines += lines;
+
+    if (child.rowMask(FIELD_HIDDEN_ROWS - 1) != 0)  // Topped out
+        return SCORE_GAME_OVER;
+
+    // Without a line clear only the rows of the piece changed
+    uint64_t childKey = 0;
+    if (context.cache != NULL)
+        childKey = lines == 0 ? zobristUpdateKey(fieldKey, field, child, tetromino.y, tetromino.y + tetrominoSize(tetromino) - 1)
+            : zobristFieldKey(child);
+    if (depth <= 1)
+        return cachedEvaluation(child, childKey, totalLines, context);
+
+    if (*context.timedOut || Clock::now() > context.deadline){
+        *context.timedOut = true;
+        return SCORE_GAME_OVER;
+    }
+
+    Placement placements[MAX_PLACEMENTS];
+    Tetromino next = { spawnX(field), SPAWN_Y, true, preview[0], 0 };
+    unsigned int nPlacements = cachedPlacements(child, childKey, next, placements, context);
+
+    double best = SCORE_GAME_OVER;
+    for (unsigned int i = 0; i < nPlacements; i++){
+        double score = searchPlacement(child, childKey, placements[i], preview[0], preview + 1, depth - 1, totalLines, context);
+        if (score > best)
+            best = score;
+    }
+
+    return best;
+}
+
+Bot::Bot(const BotConfig& config) : mConfig(config){
+    if (mConfig.depth == 0)
+        mConfig.depth = 1;
+    if (mConfig.depth > MAX_SEARCH_DEPTH)
+        mConfig.depth = MAX_SEARCH_DEPTH;
+
+    if (mConfig.threads != 1)
+        mPool.reset(new WorkStealingPool(mConfig.threads));
+    if (mConfig.cacheSizeLog2 > 0)
+        mCache.reset(new TranspositionTable(mConfig.cacheSizeLog2));
+}
+
+Placement Bot::findBestPlacement(const Field& field, const Tetromino& active,
+        const unsigned char* preview, unsigned int nPreview, std::chrono::microseconds budget){
+    TRACE_SCOPE("findBestPlacement");
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = budget == std::chrono::microseconds::max() ? Clock::time_point::max() : start + budget;
+
+    SearchContext root;
+    root.cache = mCache.get();
+    uint64_t fieldKey = mCache ? zobristFieldKey(field) : 0;
+
+    Placement candidates[MAX_PLACEMENTS];
+    unsigned int nCandidates = cachedPlacements(field, fieldKey, active, candidates, root);
+    if (mCache)
+        mCache->addCounts(root.hits, root.misses);
+    if (nCandidates == 0)
+        return Placement();
+
+    unsigned int maxDepth = mConfig.depth < nPreview + 1 ? mConfig.depth : nPreview + 1;
+    Placement best;
+
+    // Everything one level of the search shares, tasks only carry a pointer to it and their index
+    struct SearchLevel {
+        const Field* field;
+        uint64_t fieldKey;
+        const Placement* candidates;
+        unsigned char shape;
+        const unsigned char* preview;
+        unsigned int depth;
+        const HeuristicWeights* weights;
+        Clock::time_point deadline;
+        std::atomic<bool> timedOut;
+        TranspositionTable* cache;
+        double scores[MAX_PLACEMENTS];
+    };
+
+    SearchLevel level;
+    level.field = &field;
+    level.fieldKey = fieldKey;
+    level.candidates = candidates;
+    level.shape = active.shape;
+    level.preview = preview;
+    level.weights = &mConfig.weights;
+    level.cache = mCache.get();
+
+    // Deepen one piece at a time, the first level always completes
+    for (unsigned int depth = 1; depth <= maxDepth; depth++){
+        // One event per level, an event per candidate cost the bot several percent
+        TRACE_SCOPE("searchDepth");
+        level.depth = depth;
+        level.deadline = depth == 1 ? Clock::time_point::max() : deadline;
+        level.timedOut = false;
+
+        for (unsigned int i = 0; i < nCandidates; i++){
+            SearchLevel* l = &level;
+            auto evaluate = [l, i]{
+                SearchContext context;
+                context.weights = l->weights;
+                context.deadline = l->deadline;
+                context.timedOut = &l->timedOut;
+                context.cache = l->cache;
+
+                l->scores[i] = searchPlacement(*l->field, l->fieldKey, l->candidates[i], l->shape, l->preview, l->depth, 0, context);
+                if (context.cache != NULL)
+                    context.cache->addCounts(context.hits, context.misses);
+            };
+
+            if (mPool)
+                mPool->submit(evaluate);
+            else
+                evaluate();
+        }
+        if (mPool)
+            mPool->wait();
+
+        if (level.timedOut)
+            break;
+
+        const double* scores = level.scores;
+
+        unsigned int bestIndex = 0;
+        for (unsigned int i = 1; i < nCandidates; i++)
+            if (scores[i] > scores[bestIndex])
+                bestIndex = i;
+
+        best = candidates[bestIndex];
+        best.score = scores[bestIndex];
+
+        if (Clock::now() > deadline)
+            break;
+    }
+
+    return best;
+}
+
+Placement Bot::findBestPlacement(const GameState& game, std::chrono::microseconds budget){
+    unsigned char preview = game.nextTetromino().shape;
+    return findBestPlacement(game.field(), game.activeTetromino(), &preview, 1, budget);
+}
+
+Autopilot::Autopilot(Bot& bot, std::chrono::microseconds budget)
+    : mBot(bot), mBudget(budget), mPlanned(false), mPlacedCount(0), mRotateAttempts(0), mMoveAttempts(0){
+}
+
+GameInput Autopilot::nextInput(const GameState& game){
+    /* Plans once per piece, then rotates, shifts and finally drops
+     * the piece, one action per call */
+    GameInput input;
+
+    if (game.isGameOver()){
+        mPlanned = false;
+        return input;
+    }
+
+    if (!mPlanned || game.placedCount() != mPlacedCount){
+        mTarget = mBot.findBestPlacement(game, mBudget);
+        mPlacedCount = game.placedCount();
+        mPlanned = true;
+        mRotateAttempts = 0;
+        mMoveAttempts = 0;
+    }
+
+    const Tetromino& tetromino = game.activeTetromino();
+
+    if (!mTarget.valid)
+        input.drop = true;
+    else if (tetromino.rotation != mTarget.rotation && mRotateAttempts < 4){
+        input.rotate = true;
+        mRotateAttempts++;
+    }
+    else if (tetromino.x != mTarget.x && mMoveAttempts < 2 * FIELD_COLS){
+        input.direction = tetromino.x < mTarget.x ? DIR_RIGHT : DIR_LEFT;
+        mMoveAttempts++;
+    }
+    else
+        input.drop = true;
+
+    return input;
+}
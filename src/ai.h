@@ -0,0 +1,90 @@
+#ifndef TETRIS_AI_H
+#define TETRIS_AI_H
+
+#include <chrono>
+#include <memory>
+
+#include "game.h"
+#include "thread_pool.h"
+#include "transposition.h"
+
+const unsigned int MAX_PLACEMENTS = 64;  // Upper bound of distinct final placements of one piece
+const unsigned int MAX_SEARCH_DEPTH = 8;
+
+// Weights of the field features, a higher score is a better field
+struct HeuristicWeights {
+    double aggregateHeight = -0.510066;
+    double linesCleared = 0.760666;
+    double holes = -0.35663;
+    double bumpiness = -0.184483;
+};
+
+struct BotConfig {
+    HeuristicWeights weights;
+    unsigned int depth = 2;    // Number of known pieces to search, 2 looks at the next piece
+    unsigned int threads = 0;  // Search threads, 0 uses all cores and 1 searches on the caller
+    unsigned int cacheSizeLog2 = 16;  // Transposition table entries as a power of 2, 0 disables it
+};
+
+/* Final resting place of a piece. It is reached by rotating the spawned
+ * piece until it has the given rotation index, shifting it to column x
+ * and hard dropping it */
+struct Placement {
+    bool valid = false;
+    unsigned char rotation = 0;
+    char x = 0;
+    char y = 0;
+    double score = 0;
+};
+
+// Every distinct placement reachable from the spawn position through move/rotate
+unsigned int enumeratePlacements(const Field& field, const Tetromino& tetromino, Placement* placements);
+
+double evaluateField(const Field& field, unsigned char linesCleared, const HeuristicWeights& weights);
+
+/* Placement search over the active piece and the known preview pieces.
+ * Top level candidates are evaluated in parallel, and the search deepens
+ * one piece at a time until the configured depth or the time budget is
+ * reached, returning the best placement of the deepest finished level */
+class Bot {
+    public:
+        Bot(const BotConfig& config = BotConfig());
+
+        Placement findBestPlacement(const Field& field, const Tetromino& active,
+                const unsigned char* preview, unsigned int nPreview,
+                std::chrono::microseconds budget = std::chrono::microseconds::max());
+
+        Placement findBestPlacement(const GameState& game,
+                std::chrono::microseconds budget = std::chrono::microseconds::max());
+
+        const BotConfig& config() const { return mConfig; }
+
+        // Shared by every search of this bot, NULL when disabled
+        const TranspositionTable* cache() const { return mCache.get(); }
+
+    private:
+        BotConfig mConfig;
+        std::unique_ptr<WorkStealingPool> mPool;
+        std::unique_ptr<TranspositionTable> mCache;
+};
+
+/* Turns the placements of a Bot into one GameInput per call, so the bot
+ * plays through the same step() path as a human player */
+class Autopilot {
+    public:
+        Autopilot(Bot& bot, std::chrono::microseconds budget);
+
+        GameInput nextInput(const GameState& game);
+
+    private:
+        Bot& mBot;
+        std::chrono::microseconds mBudget;
+
+        bool mPlanned;
+        uint32_t mPlacedCount;
+        unsigned char mRotateAttempts;
+        unsigned char mMoveAttempts;
+        Placement mTarget;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> gAllocations(0);
+static std::atomic<uint64_t> gDeallocations(0);
+static thread_local uint64_t tAllocations = 0;
+
+uint64_t allocationCount(){
+    return gAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t deallocationCount(){
+    return gDeallocations.load(std::memory_order_relaxed);
+}
+
+uint64_t threadAllocationCount(){
+    return tAllocations;
+}
+
+void checkNoAllocations(uint64_t count, const char* what){
+    if (count == 0)
+        return;
+
+    fprintf(stderr, "%llu allocations %s, expected none!\n", static_cast<unsigned long long>(count), what);
+    std::abort();
+}
+
+static void* countedAlloc(std::size_t size){
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    tAllocations++;
+    return std::malloc(size > 0 ? size : 1);
+}
+
+static void* countedAlignedAlloc(std::size_t size, std::align_val_t align){
+    // aligned_alloc wants the size to be a multiple of the alignment
+    std::size_t alignment = static_cast<std::size_t>(align);
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    tAllocations++;
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+static void countedFree(void* ptr){
+    if (ptr == nullptr)
+        return;
+
+    gDeallocations.fetch_add(1, std::memory_order_relaxed);
+    std::free(ptr);
+}
+
+/* The remaining forms (nothrow, sized delete) forward to these in the
+ * standard library, so replacing these is enough to see every call */
+void* operator new(std::size_t size){
+    void* ptr = countedAlloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size){
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t align){
+    void* ptr = countedAlignedAlloc(size, align);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size, std::align_val_t align){
+    return operator new(size, align);
+}
+
+void operator delete(void* ptr) noexcept{
+    countedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept{
+    countedFree(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept{
+    countedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept{
+    countedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept{
+    countedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept{
+    countedFree(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept{
+    countedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept{
+    countedFree(ptr);
+}
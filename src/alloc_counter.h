@@ -0,0 +1,19 @@
+#ifndef TETRIS_ALLOC_COUNTER_H
+#define TETRIS_ALLOC_COUNTER_H
+
+#include <cstdint>
+
+/* Counts calls to the global operator new and delete. The counting
+ * operators live in alloc_counter.cpp and replace the standard ones in any
+ * program that links it, other programs don't pay for the counting */
+uint64_t allocationCount();
+uint64_t deallocationCount();
+
+// Allocations made by the calling thread only
+uint64_t threadAllocationCount();
+
+/* Gameplay is expected to run without allocating once it is warmed up.
+ * Reports what allocated and aborts if the count isn't 0 */
+void checkNoAllocations(uint64_t count, const char* what);
+
+#endif
@@ -0,0 +1,335 @@
+#include "archive.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const unsigned char ARCHIVE_MAGIC[4] = {'T', 'R', 'P', 'A'};
+
+static void putKeyframe(std::vector<unsigned char>& out, const ReplayCursor& cursor, uint64_t step, const GameSnapshot& snapshot){
+    size_t start = out.size();
+
+    putLE(out, cursor.offset, 8);
+    putLE(out, cursor.emptySteps, 8);
+    out.push_back(cursor.pendingBits);
+    out.push_back(cursor.atEnd);
+    putLE(out, step, 8);
+
+    for (unsigned char r = 0; r < FIELD_ROWS; r++)
+        for (unsigned char c = 0; c < FIELD_COLS; c++)
+            out.push_back(snapshot.colors[r][c]);
+
+    out.push_back(static_cast<unsigned char>(snapshot.active.x));
+    out.push_back(static_cast<unsigned char>(snapshot.active.y));
+    out.push_back(snapshot.active.visible);
+    out.push_back(snapshot.active.shape);
+    out.push_back(snapshot.active.rotation);
+    out.push_back(snapshot.nextShape);
+
+    putLE(out, snapshot.score, 4);
+    putLE(out, snapshot.placedCount, 4);
+    putLE(out, snapshot.tickTimer, 4);
+    putLE(out, snapshot.maxTickTime, 4);
+    out.push_back(snapshot.gameOver);
+
+    for (unsigned char i = 0; i < 4; i++)
+        putLE(out, snapshot.pieces.random[i], 8);
+    for (unsigned char i = 0; i < NUM_SHAPES; i++)
+        out.push_back(snapshot.pieces.bag[i]);
+    out.push_back(snapshot.pieces.bagLeft);
+    out.push_back(snapshot.pieces.queueSize);
+    for (unsigned int i = 0; i < PieceGenerator::MAX_PEEK; i++)
+        out.push_back(snapshot.pieces.queue[i]);
+
+    out.resize(start + ARCHIVE_KEYFRAME_SIZE, 0);
+}
+
+static bool getKeyframe(const unsigned char* in, ReplayCursor& cursor, GameSnapshot& snapshot){
+    cursor.offset = getLE(in, 8);
+    cursor.emptySteps = getLE(in + 8, 8);
+    cursor.pendingBits = in[16];
+    cursor.atEnd = in[17] != 0;
+    in += 26;  // Step number is only informational
+
+    for (unsigned char r = 0; r < FIELD_ROWS; r++)
+        for (unsigned char c = 0; c < FIELD_COLS; c++)
+            snapshot.colors[r][c] = *in++;
+
+    snapshot.active.x = static_cast<char>(in[0]);
+    snapshot.active.y = static_cast<char>(in[1]);
+    snapshot.active.visible = in[2] != 0;
+    snapshot.active.shape = in[3];
+    snapshot.active.rotation = in[4] & 3;
+    snapshot.nextShape = in[5];
+    in += 6;
+
+    snapshot.score = static_cast<uint32_t>(getLE(in, 4));
+    snapshot.placedCount = static_cast<uint32_t>(getLE(in + 4, 4));
+    snapshot.tickTimer = static_cast<uint32_t>(getLE(in + 8, 4));
+    snapshot.maxTickTime = static_cast<uint32_t>(getLE(in + 12, 4));
+    snapshot.gameOver = in[16] != 0;
+    in += 17;
+
+    for (unsigned char i = 0; i < 4; i++)
+        snapshot.pieces.random[i] = getLE(in + 8 * i, 8);
+    in += 32;
+    for (unsigned char i = 0; i < NUM_SHAPES; i++)
+        snapshot.pieces.bag[i] = *in++;
+    snapshot.pieces.bagLeft = *in++;
+    snapshot.pieces.queueSize = *in++;
+    for (unsigned int i = 0; i < PieceGenerator::MAX_PEEK; i++)
+        snapshot.pieces.queue[i] = *in++;
+
+    // Shapes index the tetromino table, don't trust them blindly
+    if (snapshot.active.shape >= NUM_SHAPES || snapshot.nextShape >= NUM_SHAPES)
+        return false;
+    for (unsigned char i = 0; i < NUM_SHAPES; i++)
+        if (snapshot.pieces.bag[i] >= NUM_SHAPES)
+            return false;
+    for (unsigned int i = 0; i < PieceGenerator::MAX_PEEK; i++)
+        if (snapshot.pieces.queue[i] >= NUM_SHAPES)
+            return false;
+
+    return true;
+}
+
+struct KeyframeBuilder {
+    std::vector<unsigned char>* keyframes;
+    uint32_t interval;
+    uint32_t lastPlaced;
+};
+
+static void addKeyframe(const GameState& game, const ReplayDecoder& decoder, uint64_t step, void* userdata){
+    // One keyframe each time the piece count reaches a multiple of the interval
+    KeyframeBuilder& builder = *static_cast<KeyframeBuilder*>(userdata);
+    if (game.placedCount() == builder.lastPlaced)
+        return;
+
+    builder.lastPlaced = game.placedCount();
+    if (builder.lastPlaced % builder.interval == 0)
+        putKeyframe(*builder.keyframes, decoder.cursor(), step, game.snapshot());
+}
+
+ArchiveWriter::ArchiveWriter(){
+    mFile = NULL;
+    mMaxGames = 0;
+    mKeyframeInterval = DEFAULT_KEYFRAME_INTERVAL;
+    mOffset = 0;
+}
+
+ArchiveWriter::~ArchiveWriter(){
+    close();
+}
+
+bool ArchiveWriter::open(const char* path, uint32_t maxGames, uint32_t keyframeInterval){
+    close();
+
+    mFile = fopen(path, "wb");
+    if (mFile == NULL){
+        printf("Could not open %s for writing!\n", path);
+        return false;
+    }
+
+    mMaxGames = maxGames;
+    mKeyframeInterval = keyframeInterval > 0 ? keyframeInterval : DEFAULT_KEYFRAME_INTERVAL;
+    mEntries.clear();
+
+    // Games start after the space reserved for the header and index
+    mOffset = ARCHIVE_HEADER_SIZE + static_cast<uint64_t>(maxGames) * ARCHIVE_ENTRY_SIZE;
+    fseek(mFile, mOffset, SEEK_SET);
+    return true;
+}
+
+ReplayStatus ArchiveWriter::add(const char* player, const unsigned char* replay, size_t size){
+    if (mFile == NULL || mEntries.size() >= mMaxGames)
+        return REPLAY_CORRUPT;
+
+    ReplayDecoder decoder;
+    if (!decoder.open(replay, size))
+        return REPLAY_CORRUPT;
+
+    // Keyframe 0 is the start of the game
+    mKeyframes.clear();
+    ReplayCursor start = decoder.cursor();
+    putKeyframe(mKeyframes, start, 0, GameState(decoder.header().seed, decoder.header().pieceMode).snapshot());
+
+    KeyframeBuilder builder = {&mKeyframes, mKeyframeInterval, 0};
+    ReplayResult result = verifyReplay(replay, size, addKeyframe, &builder);
+    if (result.status != REPLAY_OK)
+        return result.status;
+
+    ArchiveEntry entry = {};
+    strncpy(entry.player, player, ARCHIVE_PLAYER_SIZE);
+    entry.seed = result.seed;
+    entry.replayOffset = mOffset;
+    entry.keyframeOffset = mOffset + size;
+    entry.replayLength = size;
+    entry.score = result.simulated.score;
+    entry.placedCount = result.simulated.placedCount;
+    entry.keyframeCount = mKeyframes.size() / ARCHIVE_KEYFRAME_SIZE;
+
+    fwrite(replay, 1, size, mFile);
+    fwrite(mKeyframes.data(), 1, mKeyframes.size(), mFile);
+    mOffset += size + mKeyframes.size();
+
+    mEntries.push_back(entry);
+    return REPLAY_OK;
+}
+
+bool ArchiveWriter::close(){
+    /* Fills in the header and the index now that every game is known */
+    if (mFile == NULL)
+        return false;
+
+    std::vector<unsigned char> head;
+    for (unsigned char ch : ARCHIVE_MAGIC)
+        head.push_back(ch);
+    putLE(head, ARCHIVE_VERSION, 4);
+    putLE(head, mEntries.size(), 4);
+    putLE(head, mKeyframeInterval, 4);
+    head.resize(ARCHIVE_HEADER_SIZE, 0);
+
+    for (const ArchiveEntry& entry : mEntries){
+        for (size_t i = 0; i < ARCHIVE_PLAYER_SIZE; i++)
+            head.push_back(entry.player[i]);
+        putLE(head, entry.seed, 8);
+        putLE(head, entry.replayOffset, 8);
+        putLE(head, entry.keyframeOffset, 8);
+        putLE(head, entry.replayLength, 4);
+        putLE(head, entry.score, 4);
+        putLE(head, entry.placedCount, 4);
+        putLE(head, entry.keyframeCount, 4);
+    }
+
+    fseek(mFile, 0, SEEK_SET);
+    bool ok = fwrite(head.data(), 1, head.size(), mFile) == head.size();
+    ok = fclose(mFile) == 0 && ok;
+    mFile = NULL;
+
+    if (!ok)
+        printf("Could not write archive index!\n");
+    return ok;
+}
+
+ReplayArchive::ReplayArchive(){
+    mData = NULL;
+    mSize = 0;
+    mGames = 0;
+    mKeyframeInterval = 0;
+}
+
+ReplayArchive::~ReplayArchive(){
+    close();
+}
+
+bool ReplayArchive::open(const char* path){
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0){
+        printf("Could not open archive %s!\n", path);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < ARCHIVE_HEADER_SIZE){
+        printf("%s is not a replay archive!\n", path);
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED){
+        printf("Could not map archive %s!\n", path);
+        return false;
+    }
+
+    mData = static_cast<const unsigned char*>(data);
+    mSize = info.st_size;
+
+    uint32_t games = static_cast<uint32_t>(getLE(mData + 8, 4));
+    if (std::memcmp(mData, ARCHIVE_MAGIC, 4) != 0 || getLE(mData + 4, 4) != ARCHIVE_VERSION
+            || ARCHIVE_HEADER_SIZE + static_cast<uint64_t>(games) * ARCHIVE_ENTRY_SIZE > mSize){
+        printf("%s is not a replay archive!\n", path);
+        close();
+        return false;
+    }
+
+    mGames = games;
+    mKeyframeInterval = static_cast<uint32_t>(getLE(mData + 12, 4));
+    if (mKeyframeInterval == 0)
+        mKeyframeInterval = DEFAULT_KEYFRAME_INTERVAL;
+    return true;
+}
+
+void ReplayArchive::close(){
+    if (mData != NULL)
+        munmap(const_cast<unsigned char*>(mData), mSize);
+
+    mData = NULL;
+    mSize = 0;
+    mGames = 0;
+}
+
+ArchiveEntry ReplayArchive::entry(uint32_t game) const{
+    const unsigned char* in = mData + ARCHIVE_HEADER_SIZE + static_cast<size_t>(game) * ARCHIVE_ENTRY_SIZE;
+
+    ArchiveEntry entry = {};
+    std::memcpy(entry.player, in, ARCHIVE_PLAYER_SIZE);
+    in += ARCHIVE_PLAYER_SIZE;
+
+    entry.seed = getLE(in, 8);
+    entry.replayOffset = getLE(in + 8, 8);
+    entry.keyframeOffset = getLE(in + 16, 8);
+    entry.replayLength = static_cast<uint32_t>(getLE(in + 24, 4));
+    entry.score = static_cast<uint32_t>(getLE(in + 28, 4));
+    entry.placedCount = static_cast<uint32_t>(getLE(in + 32, 4));
+    entry.keyframeCount = static_cast<uint32_t>(getLE(in + 36, 4));
+    return entry;
+}
+
+bool ReplayArchive::openReplay(uint32_t game, ReplayDecoder& decoder) const{
+    if (game >= mGames)
+        return false;
+
+    ArchiveEntry e = entry(game);
+    if (e.replayOffset > mSize || e.replayLength > mSize - e.replayOffset)
+        return false;
+
+    return decoder.open(mData + e.replayOffset, e.replayLength);
+}
+
+bool ReplayArchive::seek(uint32_t game, uint32_t piece, GameState& state, ReplayDecoder& decoder) const{
+    if (!openReplay(game, decoder))
+        return false;
+
+    ArchiveEntry e = entry(game);
+    if (e.keyframeCount == 0 || e.keyframeOffset > mSize
+            || static_cast<uint64_t>(e.keyframeCount) * ARCHIVE_KEYFRAME_SIZE > mSize - e.keyframeOffset)
+        return false;
+
+    // Closest keyframe at or before the piece
+    uint32_t k = piece / mKeyframeInterval;
+    if (k >= e.keyframeCount)
+        k = e.keyframeCount - 1;
+
+    ReplayCursor cursor;
+    GameSnapshot snapshot;
+    if (!getKeyframe(mData + e.keyframeOffset + static_cast<size_t>(k) * ARCHIVE_KEYFRAME_SIZE, cursor, snapshot)
+            || !decoder.seek(cursor))
+        return false;
+
+    const ReplayHeader& header = decoder.header();
+    state = GameState(header.seed, header.pieceMode);
+    state.restore(snapshot);
+
+    // Less than one interval of pieces left to simulate
+    GameInput input;
+    while (state.placedCount() < piece && !state.isGameOver() && decoder.next(input))
+        state.step(input, header.stepMs);
+
+    return true;
+}
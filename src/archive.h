@@ -0,0 +1,103 @@
+#ifndef TETRIS_ARCHIVE_H
+#define TETRIS_ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "game.h"
+#include "replay.h"
+
+/* Many replays packed into one file that is read through mmap. All
+ * integers are little endian:
+ *
+ *   header     "TRPA", version (u32), games (u32), keyframe interval (u32), reserved (16 bytes)
+ *   index      one 64 byte entry per game, right after the header
+ *   games      for every game its replay bytes followed by its keyframes
+ *
+ * An index entry is the player name (24 bytes, zero padded), seed (u64),
+ * replay offset (u64), keyframe offset (u64), replay length (u32), score
+ * (u32), pieces (u32) and keyframe count (u32). Keyframe k is the complete
+ * game state right after piece k * interval locked, together with the
+ * replay position it continues from, so any piece of any game is reached
+ * by reading one keyframe and simulating less than interval pieces */
+const uint32_t ARCHIVE_VERSION = 1;
+const size_t ARCHIVE_HEADER_SIZE = 32;
+const size_t ARCHIVE_ENTRY_SIZE = 64;
+const size_t ARCHIVE_KEYFRAME_SIZE = 352;
+const size_t ARCHIVE_PLAYER_SIZE = 24;
+const uint32_t DEFAULT_KEYFRAME_INTERVAL = 32;
+
+struct ArchiveEntry {
+    char player[ARCHIVE_PLAYER_SIZE + 1];
+    uint64_t seed;
+    uint64_t replayOffset;
+    uint64_t keyframeOffset;
+    uint32_t replayLength;
+    uint32_t score;
+    uint32_t placedCount;
+    uint32_t keyframeCount;
+};
+
+/* Writes an archive for a known maximum number of games. The index space
+ * is reserved up front and filled in by close() */
+class ArchiveWriter {
+    public:
+        ArchiveWriter();
+        ~ArchiveWriter();
+
+        bool open(const char* path, uint32_t maxGames, uint32_t keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+
+        /* Re-simulates the replay to build its keyframes. Only replays that
+         * verify are added, the returned status says why one was not */
+        ReplayStatus add(const char* player, const unsigned char* replay, size_t size);
+
+        bool close();
+
+        uint32_t size() const { return mEntries.size(); }
+
+    private:
+        FILE* mFile;
+        uint32_t mMaxGames;
+        uint32_t mKeyframeInterval;
+        uint64_t mOffset;  // Where the next game goes
+
+        std::vector<ArchiveEntry> mEntries;
+        std::vector<unsigned char> mKeyframes;  // Reused for every game
+};
+
+// Read-only view of an archive mapped into memory
+class ReplayArchive {
+    public:
+        ReplayArchive();
+        ~ReplayArchive();
+
+        ReplayArchive(const ReplayArchive&) = delete;
+        ReplayArchive& operator=(const ReplayArchive&) = delete;
+
+        bool open(const char* path);
+        void close();
+
+        uint32_t size() const { return mGames; }
+        uint32_t keyframeInterval() const { return mKeyframeInterval; }
+
+        // Reads one index entry, game < size()
+        ArchiveEntry entry(uint32_t game) const;
+
+        // Decoder over the replay of a game, straight from the mapping
+        bool openReplay(uint32_t game, ReplayDecoder& decoder) const;
+
+        /* Puts the game into the state right after the given piece locked, 0
+         * for the start of the game, and the decoder at the step after it.
+         * Past the last piece it stops at the end of the replay */
+        bool seek(uint32_t game, uint32_t piece, GameState& state, ReplayDecoder& decoder) const;
+
+    private:
+        const unsigned char* mData;
+        size_t mSize;
+        uint32_t mGames;
+        uint32_t mKeyframeInterval;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+#include "archive.h"
+
+/* Packs replays into an archive and looks inside archives without
+ * re-running whole games.
+ *
+ * Usage: tetris-archive pack <archive> [-p player] [-k keyframe interval] <replay file or directory>...
+ *        tetris-archive list <archive>
+ *        tetris-archive show <archive> <game> <piece> */
+
+bool readFile(const std::string& path, std::vector<unsigned char>& data){
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+int pack(int argc, char* args[]){
+    std::string player = "unknown";
+    uint32_t interval = DEFAULT_KEYFRAME_INTERVAL;
+    std::vector<std::string> files;
+
+    for (int i = 3; i < argc; i++){
+        std::string arg = args[i];
+        if (arg == "-p" && i + 1 < argc)
+            player = args[++i];
+        else if (arg == "-k" && i + 1 < argc)
+            interval = std::atoi(args[++i]);
+        else if (std::filesystem::is_directory(arg)){
+            for (const auto& entry : std::filesystem::directory_iterator(arg))
+                if (entry.is_regular_file() && entry.path().extension() == ".trp")
+                    files.push_back(entry.path().string());
+        }
+        else
+            files.push_back(arg);
+    }
+
+    ArchiveWriter writer;
+    if (!writer.open(args[2], files.size(), interval))
+        return 1;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<unsigned char> data;
+    unsigned long long bytes = 0;
+    for (const std::string& file : files){
+        if (!readFile(file, data)){
+            std::cout << file << ": unreadable, skipped\n";
+            continue;
+        }
+
+        ReplayStatus status = writer.add(player.c_str(), data.data(), data.size());
+        if (status != REPLAY_OK)
+            std::cout << file << ": does not verify, skipped\n";
+        bytes += data.size();
+    }
+
+    unsigned int nGames = writer.size();
+    if (!writer.close())
+        return 1;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Packed " << nGames << " of " << files.size() << " replays (" << bytes << " bytes) in " << seconds << " s\n";
+    return nGames == files.size() ? 0 : 1;
+}
+
+int list(const char* path){
+    ReplayArchive archive;
+    if (!archive.open(path))
+        return 1;
+
+    printf("%u games, keyframe every %u pieces\n", archive.size(), archive.keyframeInterval());
+    printf("%6s  %-24s  %20s  %8s  %7s  %9s\n", "game", "player", "seed", "score", "pieces", "keyframes");
+    for (uint32_t i = 0; i < archive.size(); i++){
+        ArchiveEntry e = archive.entry(i);
+        printf("%6u  %-24s  %20llu  %8u  %7u  %9u\n", i, e.player, static_cast<unsigned long long>(e.seed),
+                e.score, e.placedCount, e.keyframeCount);
+    }
+
+    return 0;
+}
+
+int show(const char* path, uint32_t game, uint32_t piece){
+    ReplayArchive archive;
+    if (!archive.open(path))
+        return 1;
+
+    GameState state(0);
+    ReplayDecoder decoder;
+
+    auto start = std::chrono::steady_clock::now();
+    bool found = archive.seek(game, piece, state, decoder);
+    double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    if (!found){
+        printf("No game %u in %s\n", game, path);
+        return 1;
+    }
+
+    printf("Game %u after piece %u (reached in %.1f us): score %u%s\n", game, state.placedCount(), micros,
+            state.score(), state.isGameOver() ? ", game over" : "");
+
+    const Field& field = state.field();
+    const Tetromino& active = state.activeTetromino();
+    for (unsigned char r = 0; r < field.rows(); r++){
+        printf("|");
+        for (unsigned char c = 0; c < field.cols(); c++){
+            int tr = r - active.y;
+            int tc = c - active.x;
+            bool inPiece = active.visible && tr >= 0 && tr < tetrominoSize(active) && tc >= 0 && tc < tetrominoSize(active)
+                && tetrominoCell(active, tr, tc);
+
+            if (inPiece)
+                printf("@");
+            else if (field.get(r, c) != 0)
+                printf("%c", '0' + field.get(r, c));
+            else
+                printf(".");
+        }
+        printf("|\n");
+    }
+
+    return 0;
+}
+
+int main(int argc, char* args[]){
+    std::string command = argc > 1 ? args[1] : "";
+
+    if (command == "pack" && argc > 3)
+        return pack(argc, args);
+    if (command == "list" && argc > 2)
+        return list(args[2]);
+    if (command == "show" && argc > 4)
+        return show(args[2], std::atoi(args[3]), std::atoi(args[4]));
+
+    std::cout << "Usage: tetris-archive pack <archive> [-p player] [-k keyframe interval] <replay file or directory>...\n";
+    std::cout << "       tetris-archive list <archive>\n";
+    std::cout << "       tetris-archive show <archive> <game> <piece>\n";
+    return 1;
+}
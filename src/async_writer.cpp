@@ -0,0 +1,80 @@
+#include "async_writer.h"
+
+AsyncFileWriter::AsyncFileWriter(){
+    mFile = NULL;
+    mClosing = false;
+    mFailed = false;
+}
+
+AsyncFileWriter::~AsyncFileWriter(){
+    close();
+}
+
+bool AsyncFileWriter::open(const char* path){
+    close();
+
+    mFile = fopen(path, "wb");
+    if (mFile == NULL){
+        printf("Could not open %s for writing!\n", path);
+        return false;
+    }
+
+    mPath = path;
+    mClosing = false;
+    mFailed = false;
+    mPending.reserve(INITIAL_BUFFER_SIZE);
+    mThread = std::thread(&AsyncFileWriter::writerLoop, this);
+    return true;
+}
+
+void AsyncFileWriter::write(const void* data, size_t size){
+    if (mFile == NULL || size == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        mPending.insert(mPending.end(), bytes, bytes + size);
+    }
+    mWake.notify_one();
+}
+
+bool AsyncFileWriter::close(){
+    if (mFile == NULL)
+        return true;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosing = true;
+    }
+    mWake.notify_one();
+    mThread.join();
+
+    bool ok = !mFailed;
+    if (fclose(mFile) != 0)
+        ok = false;
+    mFile = NULL;
+    return ok;
+}
+
+void AsyncFileWriter::writerLoop(){
+    // Swaps the pending bytes out under the lock and writes them without holding it
+    std::vector<unsigned char> writing;
+    writing.reserve(INITIAL_BUFFER_SIZE);
+
+    for (;;){
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this]{ return !mPending.empty() || mClosing; });
+
+            if (mPending.empty())
+                return;
+            writing.swap(mPending);
+        }
+
+        // After an error the rest is dropped, the file can't be complete anymore
+        if (!mFailed && (fwrite(writing.data(), 1, writing.size(), mFile) != writing.size() || fflush(mFile) != 0))
+            mFailed = true;
+        writing.clear();
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef TETRIS_ASYNC_WRITER_H
+#define TETRIS_ASYNC_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Append-only file written by a background thread. write() only copies
+ * the bytes into a memory buffer, the file is written and flushed on the
+ * writer thread, so a slow disk never stalls the caller */
+class AsyncFileWriter {
+    public:
+        AsyncFileWriter();
+        ~AsyncFileWriter();
+
+        AsyncFileWriter(const AsyncFileWriter&) = delete;
+        AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+        // Creates or truncates the file and starts the writer thread
+        bool open(const char* path);
+        void write(const void* data, size_t size);
+
+        /* Writes everything still queued, then closes the file. Returns
+         * false if any write, flush or the close failed, the file is
+         * then incomplete */
+        bool close();
+
+        bool isOpen() const { return mFile != NULL; }
+        const std::string& path() const { return mPath; }
+
+    private:
+        // Both buffers start this large, so steady writing never allocates
+        static const size_t INITIAL_BUFFER_SIZE = 16384;
+
+        FILE* mFile;
+        std::string mPath;
+        std::thread mThread;
+        bool mFailed;  // Set by the writer thread, read once it is joined
+
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::vector<unsigned char> mPending;  // Filled by write(), swapped out by the writer thread
+        bool mClosing;
+
+        void writerLoop();
+};
+
+#endif
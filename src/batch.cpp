@@ -0,0 +1,237 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+
+#include <string>
+
+#include "ai.h"
+#include "alloc_counter.h"
+#include "replay.h"
+#include "game.h"
+#include "thread_pool.h"
+
+/* Runs many independent headless games across all cores and reports the
+ * aggregate throughput. Every game owns its GameState and its own seed.
+ * The player is either a random policy that rotates and shifts each piece
+ * a random amount and then hard drops it, or the built-in bot searching
+ * on the worker thread of its game. Given a directory, every game is also
+ * recorded there as <seed>.trp for tetris-replay.
+ *
+ * Usage: tetris-batch [games] [threads] [seed] [random|bot] [max pieces per game] [replay dir] */
+
+// Per-worker totals, padded so workers never write to the same cache line
+struct alignas(64) BatchStats {
+    unsigned long long games = 0;
+    unsigned long long placements = 0;
+    unsigned long long lines = 0;
+    unsigned long long score = 0;
+    unsigned long long cacheHits = 0;
+    unsigned long long cacheMisses = 0;
+};
+
+const uint16_t BATCH_STEP_MS = 5;  // Game time per step, the default logic step of the game
+
+#ifdef TETRIS_COUNT_ALLOCS
+const unsigned int ALLOC_WARMUP_PIECES = 2;  // Placements before a game must stop allocating
+#endif
+
+uint64_t gameSeed(uint64_t baseSeed, uint64_t game){
+    // Neighbouring game indices get unrelated seeds
+    uint64_t state = baseSeed + game * 0x9E3779B97F4A7C15ull;
+    return splitMix64(state);
+}
+
+StepResult playStep(GameState& game, const GameInput& input, ReplayEncoder* replay){
+    if (replay != NULL)
+        replay->step(input);
+    return game.step(input, BATCH_STEP_MS);
+}
+
+void playRandom(GameState& game, unsigned int maxPieces, BatchStats& stats, ReplayEncoder* replay){
+    std::mt19937 policy(static_cast<std::mt19937::result_type>(game.seed()));
+
+    unsigned long long placements = 0;
+    unsigned long long lines = 0;
+
+    while (!game.isGameOver() && placements < maxPieces){
+#ifdef TETRIS_COUNT_ALLOCS
+        // A recording grows its buffer, only the game itself has to be allocation free
+        uint64_t allocations = threadAllocationCount();
+        bool steady = replay == NULL && placements >= ALLOC_WARMUP_PIECES;
+#endif
+        GameInput input;
+
+        // Random rotation and shift, then drop
+        unsigned int nRotations = policy() % 4;
+        input.rotate = true;
+        for (unsigned int i = 0; i < nRotations; i++)
+            playStep(game, input, replay);
+
+        input.rotate = false;
+        input.direction = policy() % 2 ? DIR_LEFT : DIR_RIGHT;
+        unsigned int nShifts = policy() % 6;
+        for (unsigned int i = 0; i < nShifts; i++)
+            playStep(game, input, replay);
+
+        input.direction = DIR_NONE;
+        input.drop = true;
+        StepResult result = playStep(game, input, replay);
+
+        if (result.locked)
+            placements++;
+        lines += result.linesCleared;
+
+#ifdef TETRIS_COUNT_ALLOCS
+        if (steady)
+            checkNoAllocations(threadAllocationCount() - allocations, "during a random placement");
+#endif
+    }
+
+    stats.placements += placements;
+    stats.lines += lines;
+}
+
+void playBot(GameState& game, unsigned int maxPieces, BatchStats& stats, ReplayEncoder* replay){
+    // Single threaded bot, the games themselves already use every core
+    BotConfig config;
+    config.threads = 1;
+    Bot bot(config);
+    Autopilot autopilot(bot, std::chrono::microseconds::max());
+
+    unsigned long long lines = 0;
+
+    while (!game.isGameOver() && game.placedCount() < maxPieces){
+#ifdef TETRIS_COUNT_ALLOCS
+        uint64_t allocations = threadAllocationCount();
+        bool steady = replay == NULL && game.placedCount() >= ALLOC_WARMUP_PIECES;
+#endif
+        StepResult result = playStep(game, autopilot.nextInput(game), replay);
+        lines += result.linesCleared;
+
+#ifdef TETRIS_COUNT_ALLOCS
+        if (steady)
+            checkNoAllocations(threadAllocationCount() - allocations, "during a bot step");
+#endif
+    }
+
+    stats.placements += game.placedCount();
+    stats.lines += lines;
+    if (bot.cache() != NULL){
+        stats.cacheHits += bot.cache()->hits();
+        stats.cacheMisses += bot.cache()->misses();
+    }
+}
+
+bool parseNumber(const char* text, uint64_t& value){
+    // Whole decimal numbers only, so a typo is reported instead of read as 0
+    if (*text < '0' || *text > '9')
+        return false;
+
+    errno = 0;
+    char* end = NULL;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0')
+        return false;
+
+    value = parsed;
+    return true;
+}
+
+bool parseNumber(const char* text, unsigned int& value){
+    uint64_t parsed;
+    if (!parseNumber(text, parsed) || parsed > UINT_MAX)
+        return false;
+
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+int main(int argc, char* args[]){
+    unsigned int nGames = 100000;
+    unsigned int nThreads = 0;
+    uint64_t baseSeed = 1;
+    std::string policy = argc > 4 ? args[4] : "random";
+    unsigned int maxPieces = 100000;
+    std::string replayDir = argc > 6 ? args[6] : "";
+
+    if (argc > 7 || (argc > 1 && !parseNumber(args[1], nGames)) || (argc > 2 && !parseNumber(args[2], nThreads))
+            || (argc > 3 && !parseNumber(args[3], baseSeed)) || (policy != "random" && policy != "bot")
+            || (argc > 5 && !parseNumber(args[5], maxPieces))){
+        std::cout << "Usage: tetris-batch [games] [threads] [seed] [random|bot] [max pieces per game] [replay dir]\n";
+        std::string first = args[1];
+        return first == "--help" || first == "-h" ? 0 : 1;
+    }
+
+    bool useBot = policy == "bot";
+
+    WorkStealingPool pool(nThreads);
+    std::vector<BatchStats> workerStats(pool.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < nGames; i++){
+        uint64_t seed = gameSeed(baseSeed, i);
+        pool.submit([seed, useBot, maxPieces, &replayDir, &pool, &workerStats]{
+            BatchStats& stats = workerStats[pool.currentWorker()];
+            GameState game(seed);
+
+            ReplayEncoder replay;
+            ReplayEncoder* recording = NULL;
+            if (!replayDir.empty()){
+                replay.begin({seed, PIECES_BAG7, BATCH_STEP_MS});
+                recording = &replay;
+            }
+
+            if (useBot)
+                playBot(game, maxPieces, stats, recording);
+            else
+                playRandom(game, maxPieces, stats, recording);
+
+            if (recording != NULL){
+                // No frame to keep smooth here, write the whole replay at once
+                replay.finish(game);
+                std::string path = replayDir + "/" + std::to_string(seed) + ".trp";
+                FILE* file = fopen(path.c_str(), "wb");
+                bool written = file != NULL
+                    && fwrite(replay.bytes().data(), 1, replay.bytes().size(), file) == replay.bytes().size();
+                if (file != NULL && fclose(file) != 0)
+                    written = false;
+                if (!written)
+                    printf("Could not write replay %s!\n", path.c_str());
+            }
+
+            stats.games++;
+            stats.score += game.score();
+        });
+    }
+    pool.wait();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BatchStats total;
+    for (const BatchStats& s : workerStats){
+        total.games += s.games;
+        total.placements += s.placements;
+        total.lines += s.lines;
+        total.score += s.score;
+        total.cacheHits += s.cacheHits;
+        total.cacheMisses += s.cacheMisses;
+    }
+
+    std::cout << "Threads:        " << pool.size() << "\n";
+    std::cout << "Games:          " << total.games << " in " << seconds << " s\n";
+    std::cout << "Placements:     " << total.placements << "\n";
+    std::cout << "Lines:          " << total.lines << "\n";
+    std::cout << "Mean score:     " << (total.games ? total.score / total.games : 0) << "\n";
+    std::cout << "games/s:        " << total.games / seconds << "\n";
+    std::cout << "placements/s:   " << total.placements / seconds << "\n";
+    std::cout << "lines/s:        " << total.lines / seconds << "\n";
+    if (total.cacheHits + total.cacheMisses > 0)
+        std::cout << "Cache hits:     " << 100.0 * total.cacheHits / (total.cacheHits + total.cacheMisses) << " %\n";
+
+    return 0;
+}
@@ -0,0 +1,538 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ai.h"
+#include "alloc_counter.h"
+#include "game.h"
+#include "piece_generator.h"
+#include "vec_env.h"
+
+#ifdef TETRIS_BENCH_RENDER
+#include "block_batch.h"
+#include "field_renderer.h"
+#endif
+
+/* Micro benchmarks of the game's hot paths on representative fields. Every
+ * benchmark is calibrated to run for about --min-time seconds, repeated
+ * and reported as the fastest repetition in ns/op, allocations/op and
+ * ops/s. Allocations are counted by the replaced operator new linked in
+ * from alloc_counter.cpp. Field rendering is only measured when the bench
+ * is built with SDL.
+ *
+ * Usage: tetris-bench [--filter text] [--min-time seconds] [--repetitions n] [--json file|-] */
+
+typedef std::chrono::steady_clock Clock;
+
+// Recorded with the results, numbers from unoptimized builds can't be compared
+#ifdef TETRIS_BUILD_TYPE
+const char* const BUILD_TYPE = TETRIS_BUILD_TYPE;
+#else
+const char* const BUILD_TYPE = "";
+#endif
+#ifdef __OPTIMIZE__
+const bool OPTIMIZED = true;
+#else
+const bool OPTIMIZED = false;
+#endif
+
+struct BenchResult {
+    std::string name;
+    unsigned long long iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double opsPerSec;
+};
+
+// Results written here can't be optimized away
+volatile uint64_t gSink;
+
+double gMinTime = 0.2;
+unsigned int gRepetitions = 3;
+std::string gFilter;
+FILE* gReport = stdout;  // Human readable table, moves to stderr when the JSON goes to stdout
+std::vector<BenchResult> gResults;
+
+/* Runs body(n), which performs n operations and returns the nanoseconds
+ * spent on them. Bodies that need untimed setup between operations time
+ * themselves, the others go through timeOps() */
+template <typename Body>
+void runBench(const std::string& name, Body body){
+    if (!gFilter.empty() && name.find(gFilter) == std::string::npos)
+        return;
+
+    // Grow n until one run takes a noticeable part of the minimum time, then scale it up
+    uint64_t n = 1;
+    double ns = body(n);
+    while (ns < gMinTime * 1e8 && n < (1ull << 40)){
+        n *= ns < 1e5 ? 100 : 10;
+        ns = body(n);
+    }
+    if (ns < gMinTime * 1e9)
+        n = static_cast<uint64_t>(n * gMinTime * 1e9 / (ns > 1 ? ns : 1)) + 1;
+
+    BenchResult result = {name, n, 0, 0, 0};
+    uint64_t allocations = allocationCount();
+    for (unsigned int rep = 0; rep < gRepetitions; rep++){
+        double perOp = body(n) / n;
+        if (rep == 0 || perOp < result.nsPerOp)
+            result.nsPerOp = perOp;
+    }
+    result.allocsPerOp = static_cast<double>(allocationCount() - allocations) / (static_cast<double>(n) * gRepetitions);
+    result.opsPerSec = result.nsPerOp > 0 ? 1e9 / result.nsPerOp : 0;
+
+    fprintf(gReport, "%-36s %12.2f ns/op %10.3f allocs/op %14.0f ops/s\n", name.c_str(), result.nsPerOp, result.allocsPerOp, result.opsPerSec);
+    gResults.push_back(result);
+}
+
+template <typename Op>
+double timeOps(uint64_t n, Op op){
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < n; i++)
+        op(i);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/* Representative fields. Sparse has a few low rows with scattered blocks,
+ * dense fills 16 rows almost completely. Neither has a full row */
+Field makeField(unsigned char filledRows, double density, uint64_t seed){
+    std::mt19937_64 rng(seed);
+    unsigned char colors[FIELD_ROWS][FIELD_COLS] = {};
+
+    for (unsigned char r = FIELD_ROWS - filledRows; r < FIELD_ROWS; r++){
+        for (unsigned char c = 0; c < FIELD_COLS; c++)
+            if (std::uniform_real_distribution<double>(0, 1)(rng) < density)
+                colors[r][c] = 1 + rng() % NUM_SHAPES;
+
+        colors[r][rng() % FIELD_COLS] = 0;
+    }
+
+    Field field;
+    field.load(colors);
+    return field;
+}
+
+Field withFullRows(const Field& base, unsigned char nLines){
+    // Fills the lowest nLines rows completely
+    unsigned char colors[FIELD_ROWS][FIELD_COLS];
+    for (unsigned char r = 0; r < FIELD_ROWS; r++)
+        for (unsigned char c = 0; c < FIELD_COLS; c++){
+            colors[r][c] = base.get(r, c);
+            if (r >= FIELD_ROWS - nLines && colors[r][c] == 0)
+                colors[r][c] = 1 + (r + c) % NUM_SHAPES;
+        }
+
+    Field field;
+    field.load(colors);
+    return field;
+}
+
+std::vector<Tetromino> makePieces(const Field& field, unsigned int n, uint64_t seed, bool onlyFree){
+    // Random pieces spread over the field, optionally only positions that don't collide
+    std::mt19937_64 rng(seed);
+    std::vector<Tetromino> pieces;
+
+    while (pieces.size() < n){
+        Tetromino t = {static_cast<char>(static_cast<int>(rng() % (FIELD_COLS + 2)) - 1),
+            static_cast<char>(rng() % (FIELD_ROWS - 2)), true,
+            static_cast<unsigned char>(rng() % NUM_SHAPES), static_cast<unsigned char>(rng() % 4)};
+
+        if (!onlyFree || !collidesWith(t, field))
+            pieces.push_back(t);
+    }
+
+    return pieces;
+}
+
+void benchField(const char* label, const Field& field){
+    const unsigned int N_PIECES = 4096;
+    std::vector<Tetromino> anywhere = makePieces(field, N_PIECES, 1, false);
+    std::vector<Tetromino> freeSpots = makePieces(field, N_PIECES, 2, true);
+    std::string suffix = std::string("/") + label;
+
+    runBench("collidesWith" + suffix, [&](uint64_t n){
+        uint64_t hits = 0;
+        double ns = timeOps(n, [&](uint64_t i){ hits += collidesWith(anywhere[i % N_PIECES], field); });
+        gSink = hits;
+        return ns;
+    });
+
+    runBench("move" + suffix, [&](uint64_t n){
+        const Direction dirs[3] = {DIR_LEFT, DIR_RIGHT, DIR_DOWN};
+        uint64_t moved = 0;
+        double ns = timeOps(n, [&](uint64_t i){
+            Tetromino t = freeSpots[i % N_PIECES];
+            moved += move(t, field, dirs[i % 3]);
+        });
+        gSink = moved;
+        return ns;
+    });
+
+    runBench("rotate" + suffix, [&](uint64_t n){
+        uint64_t rotated = 0;
+        double ns = timeOps(n, [&](uint64_t i){
+            Tetromino t = freeSpots[i % N_PIECES];
+            rotated += rotate(t, field);
+        });
+        gSink = rotated;
+        return ns;
+    });
+
+    runBench("dropRow" + suffix, [&](uint64_t n){
+        uint64_t rows = 0;
+        double ns = timeOps(n, [&](uint64_t i){ rows += dropRow(freeSpots[i % N_PIECES], field); });
+        gSink = rows;
+        return ns;
+    });
+
+    runBench("evaluateField" + suffix, [&](uint64_t n){
+        HeuristicWeights weights;
+        double total = 0;
+        double ns = timeOps(n, [&](uint64_t i){ total += evaluateField(field, i & 3, weights); });
+        gSink = static_cast<uint64_t>(total);
+        return ns;
+    });
+
+    runBench("enumeratePlacements" + suffix, [&](uint64_t n){
+        Placement placements[MAX_PLACEMENTS];
+        uint64_t count = 0;
+        double ns = timeOps(n, [&](uint64_t i){
+            Tetromino t = {spawnX(field), SPAWN_Y, true, static_cast<unsigned char>(i % NUM_SHAPES), 0};
+            count += enumeratePlacements(field, t, placements);
+        });
+        gSink = count;
+        return ns;
+    });
+
+    // Line clears run on copies, copying is kept out of the timing
+    for (unsigned char nLines = 0; nLines <= 4; nLines++){
+        Field full = withFullRows(field, nLines);
+        runBench("flushFull" + suffix + "/" + std::to_string(nLines), [&](uint64_t n){
+            const unsigned int BATCH = 256;
+            static Field copies[BATCH];
+            uint64_t lines = 0;
+            double ns = 0;
+
+            for (uint64_t done = 0; done < n; done += BATCH){
+                unsigned int batch = n - done < BATCH ? n - done : BATCH;
+                for (unsigned int i = 0; i < batch; i++)
+                    copies[i] = full;
+
+                ns += timeOps(batch, [&](uint64_t i){ lines += copies[i].flushFull(); });
+            }
+            gSink = lines;
+            return ns;
+        });
+    }
+}
+
+template<class GameT>
+double timePlacements(uint64_t n, GameT game){
+    // endTurn runs inside step(), measured per placement: a few shifts and rotations, then the hard drop
+    std::mt19937 policy(42);
+    uint64_t lines = 0;
+
+    double ns = timeOps(n, [&](uint64_t){
+        if (game.isGameOver())
+            game.reset();
+
+        GameInput input;
+        input.rotate = policy() % 2;
+        input.direction = policy() % 2 ? DIR_LEFT : DIR_RIGHT;
+        for (unsigned int i = policy() % 5; i > 0; i--)
+            game.step(input, 0);
+
+        GameInput drop;
+        drop.drop = true;
+        lines += game.step(drop, 0).linesCleared;
+    });
+    gSink = lines;
+    return ns;
+}
+
+double timeBotPlacements(uint64_t n, unsigned int cacheSizeLog2){
+    // Whole bot turns: the search for a placement, then the steps that play it
+    BotConfig config;
+    config.threads = 1;
+    config.cacheSizeLog2 = cacheSizeLog2;
+    Bot bot(config);
+    Autopilot autopilot(bot, std::chrono::microseconds::max());
+    GameState game(42);
+
+    double ns = timeOps(n, [&](uint64_t){
+        if (game.isGameOver())
+            game.reset();
+
+        uint32_t placed = game.placedCount();
+        while (game.placedCount() == placed && !game.isGameOver())
+            game.step(autopilot.nextInput(game), 0);
+    });
+    gSink = game.score();
+    return ns;
+}
+
+void benchGame(){
+    runBench("endTurn/placement", [](uint64_t n){ return timePlacements(n, GameState(42)); });
+
+    // Bigger boards, and the standard board with its size only known at run time
+    runBench("endTurn/placement/10x40", [](uint64_t n){
+        return timePlacements(n, BasicGameState<Field10x40>(42));
+    });
+    runBench("endTurn/placement/20x44", [](uint64_t n){
+        return timePlacements(n, BasicGameState<Field20x44>(42));
+    });
+    runBench("endTurn/placement/runtime-10x22", [](uint64_t n){
+        return timePlacements(n, BasicGameState<DynamicField>(42, PIECES_BAG7, DynamicField(RuntimeDims(22, 10))));
+    });
+
+    runBench("Bot/placement", [](uint64_t n){ return timeBotPlacements(n, BotConfig().cacheSizeLog2); });
+    runBench("Bot/placement/no-cache", [](uint64_t n){ return timeBotPlacements(n, 0); });
+
+    runBench("step/idle", [](uint64_t n){
+        GameState game(42);
+        GameInput idle;
+        double ns = timeOps(n, [&](uint64_t){
+            if (game.isGameOver())
+                game.reset();
+            game.step(idle, 5);
+        });
+        gSink = game.score();
+        return ns;
+    });
+
+    // getRandomShape is now the piece generator
+    runBench("PieceGenerator::next/bag7", [](uint64_t n){
+        PieceGenerator pieces(7, PIECES_BAG7);
+        uint64_t sum = 0;
+        double ns = timeOps(n, [&](uint64_t){ sum += pieces.next(); });
+        gSink = sum;
+        return ns;
+    });
+
+    runBench("PieceGenerator::next/random", [](uint64_t n){
+        PieceGenerator pieces(7, PIECES_RANDOM);
+        uint64_t sum = 0;
+        double ns = timeOps(n, [&](uint64_t){ sum += pieces.next(); });
+        gSink = sum;
+        return ns;
+    });
+
+    runBench("PieceGenerator::generate/bag7", [](uint64_t n){
+        PieceGenerator pieces(7, PIECES_BAG7);
+        unsigned char buffer[1024];
+        uint64_t sum = 0;
+        auto start = Clock::now();
+        for (uint64_t done = 0; done < n; done += sizeof(buffer)){
+            size_t count = n - done < sizeof(buffer) ? n - done : sizeof(buffer);
+            pieces.generate(buffer, count);
+            sum += buffer[count - 1];
+        }
+        gSink = sum;
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    });
+}
+
+const unsigned int VEC_BENCH_ENVS = 4096;
+const unsigned int VEC_BENCH_ACTION_SETS = 16;
+
+std::vector<uint8_t> makeVecActions(){
+    // Mostly idle steps with some moves and drops, so games last a while
+    std::mt19937 policy(42);
+    std::vector<uint8_t> actions(VEC_BENCH_ENVS * VEC_BENCH_ACTION_SETS);
+    for (uint8_t& action : actions){
+        unsigned int r = policy() % 16;
+        action = r < NUM_VEC_ACTIONS ? static_cast<uint8_t>(r) : static_cast<uint8_t>(VEC_NOOP);
+    }
+    return actions;
+}
+
+double timeVecEnv(uint64_t n, unsigned int threads){
+    // n environment steps, taken as whole steps of every environment
+    VecEnvConfig config;
+    config.envs = VEC_BENCH_ENVS;
+    config.threads = threads;
+    config.seed = 42;
+    VecEnv env(config);
+
+    std::vector<uint8_t> actions = makeVecActions();
+    std::vector<uint8_t> observations(VEC_BENCH_ENVS * VEC_OBS_SIZE);
+    std::vector<float> rewards(VEC_BENCH_ENVS);
+    std::vector<uint8_t> dones(VEC_BENCH_ENVS);
+    env.reset(observations.data());
+
+    uint64_t steps = (n + VEC_BENCH_ENVS - 1) / VEC_BENCH_ENVS;
+    auto start = Clock::now();
+    for (uint64_t s = 0; s < steps; s++)
+        env.step(actions.data() + (s % VEC_BENCH_ACTION_SETS) * VEC_BENCH_ENVS, observations.data(), rewards.data(), dones.data());
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    gSink = observations[0] + env.scores()[0];
+    return ns * n / (steps * VEC_BENCH_ENVS);
+}
+
+void benchVecEnv(){
+    // The same games on one GameState each, with the same observations written per game
+    runBench("VecEnv/step/GameState-loop", [](uint64_t n){
+        std::vector<GameState> games;
+        for (unsigned int i = 0; i < VEC_BENCH_ENVS; i++)
+            games.emplace_back(42 + i);
+        std::vector<uint8_t> actions = makeVecActions();
+        std::vector<uint8_t> observations(VEC_BENCH_ENVS * VEC_OBS_SIZE);
+
+        uint64_t steps = (n + VEC_BENCH_ENVS - 1) / VEC_BENCH_ENVS;
+        auto start = Clock::now();
+        for (uint64_t s = 0; s < steps; s++)
+            for (unsigned int i = 0; i < VEC_BENCH_ENVS; i++){
+                GameState& game = games[i];
+                if (game.isGameOver())
+                    game.reset();
+
+                GameInput input;
+                uint8_t action = actions[(s % VEC_BENCH_ACTION_SETS) * VEC_BENCH_ENVS + i];
+                input.direction = action == VEC_LEFT ? DIR_LEFT : action == VEC_RIGHT ? DIR_RIGHT : action == VEC_DOWN ? DIR_DOWN : DIR_NONE;
+                input.rotate = action == VEC_ROTATE;
+                input.drop = action == VEC_DROP;
+                game.step(input, 5);
+
+                uint8_t* observation = &observations[i * VEC_OBS_SIZE];
+                for (unsigned char r = 0; r < FIELD_ROWS; r++)
+                    for (unsigned char c = 0; c < FIELD_COLS; c++)
+                        observation[r * FIELD_COLS + c] = game.field().get(r, c) != 0;
+
+                const Tetromino& active = game.activeTetromino();
+                for (unsigned char r = 0; r < tetrominoSize(active); r++)
+                    for (unsigned char c = 0; c < tetrominoSize(active); c++)
+                        if (tetrominoCell(active, r, c) && active.y + r >= 0 && active.y + r < FIELD_ROWS)
+                            observation[(active.y + r) * FIELD_COLS + active.x + c] = 2;
+                observation[VEC_OBS_CELLS] = active.shape;
+                observation[VEC_OBS_CELLS + 1] = game.nextTetromino().shape;
+            }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        gSink = observations[0] + games[0].score();
+        return ns * n / (steps * VEC_BENCH_ENVS);
+    });
+
+    runBench("VecEnv/step/1-thread", [](uint64_t n){ return timeVecEnv(n, 1); });
+    runBench("VecEnv/step/all-threads", [](uint64_t n){ return timeVecEnv(n, 0); });
+}
+
+#ifdef TETRIS_BENCH_RENDER
+void benchRender(const char* label, const Field& field){
+    /* Draws the game's field area with FieldRenderer into an offscreen
+     * surface with SDL's software renderer, including the rasterizing.
+     * The active tetromino changes column every frame, so the ghost is
+     * recomputed as while the player moves it. "layer" copies the
+     * retained field layer, "layer-update" redraws it first as on a frame
+     * where the field changed, "immediate" draws everything every frame */
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Renderer* renderer = target != NULL ? SDL_CreateSoftwareRenderer(target) : NULL;
+    if (renderer == NULL){
+        printf("Could not create software renderer! SDL Error: %s\n", SDL_GetError());
+        if (target != NULL)
+            SDL_FreeSurface(target);
+        return;
+    }
+
+    BlockBatch blocks;
+    if (blocks.init(renderer, BLOCK_SIZE)){
+        const char* modes[3] = {"layer", "layer-update", "immediate"};
+        for (unsigned int m = 0; m < 3; m++){
+            FieldRenderer fieldRenderer;
+            fieldRenderer.init(renderer, &blocks, m < 2);
+            if (m < 2 && !fieldRenderer.retained())
+                continue;
+
+            runBench(std::string("renderField/") + label + "/" + modes[m], [&](uint64_t n){
+                return timeOps(n, [&](uint64_t i){
+                    Tetromino active;
+                    active.shape = static_cast<unsigned char>(i % NUM_SHAPES);
+                    active.x = static_cast<char>(i % (FIELD_COLS - 3));
+                    active.y = 0;
+                    Tetromino next;
+                    next.shape = static_cast<unsigned char>((i + 1) % NUM_SHAPES);
+
+                    if (m == 1)
+                        fieldRenderer.invalidate();
+                    fieldRenderer.draw(field, active, next);
+                    SDL_RenderFlush(renderer);
+                });
+            });
+        }
+    }
+
+    blocks.free();
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(target);
+}
+#endif
+
+bool writeJson(const std::string& path){
+    FILE* out = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if (out == NULL){
+        printf("Could not open %s for writing!\n", path.c_str());
+        return false;
+    }
+
+    fprintf(out, "{\n  \"build_type\": \"%s\",\n  \"optimized\": %s,\n  \"min_time\": %g,\n  \"repetitions\": %u,\n  \"benchmarks\": [\n",
+            BUILD_TYPE, OPTIMIZED ? "true" : "false", gMinTime, gRepetitions);
+    for (size_t i = 0; i < gResults.size(); i++){
+        const BenchResult& r = gResults[i];
+        fprintf(out, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.4f, \"ops_per_sec\": %.1f}%s\n",
+                r.name.c_str(), r.iterations, r.nsPerOp, r.allocsPerOp, r.opsPerSec, i + 1 < gResults.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    return true;
+}
+
+int main(int argc, char* args[]){
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; i++){
+        std::string arg = args[i];
+        if (arg == "--filter" && i + 1 < argc)
+            gFilter = args[++i];
+        else if (arg == "--min-time" && i + 1 < argc)
+            gMinTime = std::atof(args[++i]);
+        else if (arg == "--repetitions" && i + 1 < argc)
+            gRepetitions = std::atoi(args[++i]);
+        else if (arg == "--json" && i + 1 < argc)
+            jsonPath = args[++i];
+    }
+    if (jsonPath == "-")
+        gReport = stderr;
+    if (gRepetitions == 0)
+        gRepetitions = 1;
+
+    if (!OPTIMIZED)
+        fprintf(gReport, "Warning: %s build without optimization, the numbers are not representative\n",
+                *BUILD_TYPE != '\0' ? BUILD_TYPE : "This");
+
+    Field empty;
+    Field sparse = makeField(4, 0.4, 11);
+    Field dense = makeField(16, 0.9, 12);
+
+    benchField("empty", empty);
+    benchField("sparse", sparse);
+    benchField("dense", dense);
+    benchGame();
+    benchVecEnv();
+
+#ifdef TETRIS_BENCH_RENDER
+    benchRender("sparse", sparse);
+    benchRender("dense", dense);
+#endif
+
+    if (!jsonPath.empty() && !writeJson(jsonPath))
+        return 1;
+
+    return 0;
+}
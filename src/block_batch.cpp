@@ -0,0 +1,148 @@
+#include "block_batch.h"
+
+#include <cstdio>
+
+const Uint8 GHOST_ALPHA = 0x50;
+
+Uint32 getColorFromValue(const SDL_PixelFormat* format, unsigned char blockValue){
+    switch(blockValue){
+        case 1:
+            return SDL_MapRGB(format, 0xFF, 0x00, 0x00);
+        case 2:
+            return SDL_MapRGB(format, 0x00, 0xFF, 0x00);
+        case 3:
+            return SDL_MapRGB(format, 0x00, 0x00, 0xFF);
+        case 4:
+            return SDL_MapRGB(format, 0xFF, 0xFF, 0x00);
+        case 5:
+            return SDL_MapRGB(format, 0xFF, 0x00, 0xFF);
+        case 6:
+            return SDL_MapRGB(format, 0x00, 0xFF, 0xFF);
+        case 7:
+            return SDL_MapRGB(format, 0xFF, 0x80, 0x00);
+        case 8:
+            return SDL_MapRGB(format, 0x80, 0x80, 0x80);
+        default:
+            return SDL_MapRGB(format, 0xFF, 0xFF, 0xFF);
+            break;
+    }
+}
+
+BlockBatch::BlockBatch(){
+    mRenderer = NULL;
+    mAtlas = NULL;
+    mBlockSize = 0;
+    mDrawCalls = 0;
+}
+
+BlockBatch::~BlockBatch(){
+    free();
+}
+
+void BlockBatch::free(){
+    if (mAtlas != NULL){
+        SDL_DestroyTexture(mAtlas);
+        mAtlas = NULL;
+    }
+}
+
+bool BlockBatch::init(SDL_Renderer* renderer, unsigned char blockSize){
+    /* Pre renders the atlas. Cells 0-8 are the solid blocks of each color,
+     * cells 9-17 the ghost outlines */
+    free();
+    mRenderer = renderer;
+    mBlockSize = blockSize;
+
+    SDL_Surface* surf = SDL_CreateRGBSurface(0, 2 * NUM_BLOCK_COLORS * blockSize, blockSize, 32, 0, 0, 0, 0);
+    if (surf == NULL){
+        printf("Could not create block atlas surface! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    for (unsigned char i = 0; i < NUM_BLOCK_COLORS; i++){
+        int solidX = i * blockSize;
+        SDL_Rect blockOuter = {solidX, 0, blockSize, blockSize};
+        SDL_Rect blockInner = {solidX + 2, 2, blockSize - 4, blockSize - 4};
+
+        SDL_FillRect(surf, &blockOuter, getColorFromValue(surf->format, i));
+        SDL_FillRect(surf, &blockInner, 0.4*getColorFromValue(surf->format, i));
+
+        int ghostX = (NUM_BLOCK_COLORS + i) * blockSize;
+        SDL_Rect ghostOuter = {ghostX, 0, blockSize, blockSize};
+        SDL_Rect ghostInner = {ghostX + 2, 2, blockSize - 4, blockSize - 4};
+
+        SDL_FillRect(surf, &ghostOuter, getColorFromValue(surf->format, i));
+        SDL_FillRect(surf, &ghostInner, SDL_MapRGB(surf->format, 0x00, 0x00, 0x00));
+    }
+
+    mAtlas = SDL_CreateTextureFromSurface(renderer, surf);
+    SDL_FreeSurface(surf);
+
+    if (mAtlas == NULL){
+        printf("Could not create block atlas texture! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+
+    // Ghosts get their translucency from the vertex color
+    SDL_SetTextureBlendMode(mAtlas, SDL_BLENDMODE_BLEND);
+
+    mVertices.reserve(4 * MAX_BATCH_BLOCKS);
+    mIndices.reserve(6 * MAX_BATCH_BLOCKS);
+
+    return true;
+}
+
+void BlockBatch::addBlock(int x, int y, unsigned char color, bool ghost){
+    if (mVertices.size() >= 4 * MAX_BATCH_BLOCKS)
+        flush();
+
+    float cell = ghost ? NUM_BLOCK_COLORS + color : color;
+    float u0 = cell / (2 * NUM_BLOCK_COLORS);
+    float u1 = (cell + 1) / (2 * NUM_BLOCK_COLORS);
+
+    float x0 = x;
+    float y0 = y;
+    float x1 = x + mBlockSize - 1;
+    float y1 = y + mBlockSize - 1;
+
+    SDL_Color tint = {0xFF, 0xFF, 0xFF, ghost ? GHOST_ALPHA : static_cast<Uint8>(0xFF)};
+
+    int first = mVertices.size();
+    mVertices.push_back({{x0, y0}, tint, {u0, 0}});
+    mVertices.push_back({{x1, y0}, tint, {u1, 0}});
+    mVertices.push_back({{x1, y1}, tint, {u1, 1}});
+    mVertices.push_back({{x0, y1}, tint, {u0, 1}});
+
+    const int quad[6] = {0, 1, 2, 0, 2, 3};
+    for (int i : quad)
+        mIndices.push_back(first + i);
+}
+
+void BlockBatch::flush(){
+    /* Submits every queued block. Falls back to one copy per block on
+     * SDL versions without SDL_RenderGeometry */
+    if (mVertices.empty())
+        return;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_RenderGeometry(mRenderer, mAtlas, mVertices.data(), mVertices.size(), mIndices.data(), mIndices.size());
+    mDrawCalls++;
+#else
+    int cellWidth = mBlockSize;
+    for (size_t v = 0; v < mVertices.size(); v += 4){
+        const SDL_Vertex& corner = mVertices[v];
+        int cell = static_cast<int>(corner.tex_coord.x * 2 * NUM_BLOCK_COLORS + 0.5f);
+
+        SDL_Rect src = {cell * cellWidth, 0, cellWidth, cellWidth};
+        SDL_Rect dst = {static_cast<int>(corner.position.x), static_cast<int>(corner.position.y), mBlockSize - 1, mBlockSize - 1};
+
+        SDL_SetTextureAlphaMod(mAtlas, corner.color.a);
+        SDL_RenderCopy(mRenderer, mAtlas, &src, &dst);
+        mDrawCalls++;
+    }
+    SDL_SetTextureAlphaMod(mAtlas, 0xFF);
+#endif
+
+    mVertices.clear();
+    mIndices.clear();
+}
@@ -0,0 +1,42 @@
+#ifndef TETRIS_BLOCK_BATCH_H
+#define TETRIS_BLOCK_BATCH_H
+
+#include <vector>
+#include <SDL2/SDL.h>
+
+const unsigned char NUM_BLOCK_COLORS = 9;  // Color 8 is the garbage of versus matches
+const unsigned int MAX_BATCH_BLOCKS = 2048;  // Blocks queued before the batch flushes itself, 8 full versus boards
+
+Uint32 getColorFromValue(const SDL_PixelFormat* format, unsigned char blockValue);
+
+/* Collects the blocks of a frame and submits them together. All block
+ * colors live side by side in one atlas texture, ghost blocks use the
+ * same atlas cell drawn translucent, so every queued block goes out in a
+ * single SDL_RenderGeometry call */
+class BlockBatch {
+    public:
+        BlockBatch();
+        ~BlockBatch();
+
+        bool init(SDL_Renderer* renderer, unsigned char blockSize);
+        void free();
+
+        // Queues a block of blockSize-1 pixels, leaving a 1px gap to its neighbours
+        void addBlock(int x, int y, unsigned char color, bool ghost = false);
+        void flush();
+
+        // Number of draw calls submitted since the last reset
+        unsigned int drawCalls() const { return mDrawCalls; }
+        void resetDrawCalls() { mDrawCalls = 0; }
+
+    private:
+        SDL_Renderer* mRenderer;
+        SDL_Texture* mAtlas;
+        unsigned char mBlockSize;
+
+        std::vector<SDL_Vertex> mVertices;
+        std::vector<int> mIndices;
+        unsigned int mDrawCalls;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "ai.h"
+#include "state_feed.h"
+
+/* Connects to a game started with --feed NAME from another process.
+ * "watch" prints the published state twice a second, "bot" plays the game
+ * with the built-in bot by sending inputs back through the feed, one
+ * action at a time like the autopilot does.
+ *
+ * Usage: tetris-feed NAME [watch|bot] */
+
+const std::chrono::milliseconds POLL_INTERVAL(1);
+const std::chrono::milliseconds WATCH_INTERVAL(500);
+const std::chrono::microseconds BOT_BUDGET = std::chrono::milliseconds(5);
+
+void printState(const FeedState& state, double ticksPerSecond){
+    printf("tick %llu (%.0f/s)  seed %llu  score %u  pieces %u  active %u at %d,%d r%u  next %u%s\n",
+            static_cast<unsigned long long>(state.tick), ticksPerSecond,
+            static_cast<unsigned long long>(state.seed), state.score, state.placedCount,
+            state.activeShape, state.activeX, state.activeY, state.activeRotation, state.nextShape,
+            state.gameOver ? "  GAME OVER" : "");
+}
+
+void watch(StateFeedReader& reader){
+    FeedState state;
+    uint64_t lastTick = 0;
+    auto lastTime = std::chrono::steady_clock::now();
+
+    while (true){
+        std::this_thread::sleep_for(WATCH_INTERVAL);
+        if (!reader.readLatest(state))
+            continue;
+
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - lastTime).count();
+        printState(state, lastTick > 0 ? (state.tick - lastTick) / seconds : 0.0);
+        fflush(stdout);
+        lastTick = state.tick;
+        lastTime = now;
+    }
+}
+
+void tap(StateFeedReader& reader, InputAction action){
+    // A press and release in the same step still counts as one press
+    while (!reader.pushInput(action, true) || !reader.pushInput(action, false))
+        std::this_thread::sleep_for(POLL_INTERVAL);
+}
+
+void play(StateFeedReader& reader){
+    Bot bot;
+    Field field;
+    FeedState state;
+
+    Placement target;
+    uint64_t seed = 0;
+    uint32_t placedCount = 0;
+    bool planned = false;
+    unsigned int rotateAttempts = 0;
+    unsigned int moveAttempts = 0;
+
+    while (true){
+        std::this_thread::sleep_for(POLL_INTERVAL);
+
+        /* Actions are only chosen from states that already show every
+         * input sent, otherwise the same move would be sent twice */
+        if (!reader.readLatest(state) || state.inputsApplied < reader.inputsSent())
+            continue;
+
+        if (state.gameOver){
+            planned = false;
+            continue;
+        }
+
+        if (!planned || state.placedCount != placedCount || state.seed != seed){
+            field.load(state.colors);
+            Tetromino active;
+            active.x = state.activeX;
+            active.y = state.activeY;
+            active.visible = state.activeVisible != 0;
+            active.shape = state.activeShape;
+            active.rotation = state.activeRotation;
+
+            target = bot.findBestPlacement(field, active, &state.nextShape, 1, BOT_BUDGET);
+            placedCount = state.placedCount;
+            seed = state.seed;
+            planned = true;
+            rotateAttempts = 0;
+            moveAttempts = 0;
+        }
+
+        if (!target.valid)
+            tap(reader, INPUT_DROP);
+        else if (state.activeRotation != target.rotation && rotateAttempts < 4){
+            tap(reader, INPUT_ROTATE);
+            rotateAttempts++;
+        }
+        else if (state.activeX != target.x && moveAttempts < 2 * FIELD_COLS){
+            tap(reader, state.activeX < target.x ? INPUT_RIGHT : INPUT_LEFT);
+            moveAttempts++;
+        }
+        else
+            tap(reader, INPUT_DROP);
+    }
+}
+
+int main(int argc, char* argv[]){
+    if (argc < 2 || argc > 3){
+        printf("Usage: tetris-feed NAME [watch|bot]\n");
+        return 1;
+    }
+
+    std::string mode = argc == 3 ? argv[2] : "watch";
+    if (mode != "watch" && mode != "bot"){
+        printf("Unknown mode %s\n", mode.c_str());
+        return 1;
+    }
+
+    StateFeedReader reader;
+    if (!reader.open(argv[1]))
+        return 1;
+
+    if (mode == "bot")
+        play(reader);
+    else
+        watch(reader);
+
+    return 0;
+}
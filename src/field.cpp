@@ -0,0 +1,221 @@
+#include "field.h"
+
+#include <cstring>
+
+RuntimeDims::RuntimeDims(unsigned char rows, unsigned char cols){
+    // Out of range sizes are clamped to what the field storage can hold
+    mRows = rows < 4 ? 4 : (rows > MAX_ROWS ? MAX_ROWS : rows);
+    mCols = cols < 4 ? 4 : (cols > MAX_COLS ? MAX_COLS : cols);
+}
+
+template<class Dims>
+bool BasicField<Dims>::shiftRow(uint16_t pieceRow, int x, RowMask& fieldRow) const{
+    /* Moves a piece row mask to column x. Returns false if any block
+     * ends up outside of the field boundaries */
+    if (x < 0){
+        if (x <= -16 || (pieceRow & ((1u << -x) - 1)) != 0)
+            return false;
+        fieldRow = pieceRow >> -x;
+        return true;
+    }
+
+    if (x >= cols())
+        return false;
+
+    uint64_t shifted = static_cast<uint64_t>(pieceRow) << x;
+    if (shifted & ~static_cast<uint64_t>(fullRow()))
+        return false;
+
+    fieldRow = static_cast<RowMask>(shifted);
+    return true;
+}
+
+template<class Dims>
+BasicField<Dims>::BasicField(Dims dims) : mDims(dims){
+    mRevision = 0;
+    clear();
+}
+
+template<class Dims>
+void BasicField<Dims>::clear(){
+    std::memset(mRows, 0, sizeof(mRows));
+    std::memset(mColors, 0, sizeof(mColors));
+    std::memset(mColumnTops, rows(), sizeof(mColumnTops));
+    mRevision++;
+}
+
+template<class Dims>
+bool BasicField<Dims>::collides(const uint16_t* pieceRows, unsigned char nRows, int x, int y) const{
+    // Checks if the piece collides with the field or the boundaries of the field
+    for (unsigned char r = 0; r < nRows; r++){
+        if (pieceRows[r] == 0)  // Empty row can't collide
+            continue;
+
+        int rf = y + r;
+        if (rf < 0 || rf >= rows())
+            return true;
+
+        RowMask mask;
+        if (!shiftRow(pieceRows[r], x, mask))
+            return true;
+
+        if (mRows[rf] & mask)
+            return true;
+    }
+
+    return false;
+}
+
+template<class Dims>
+void BasicField<Dims>::lock(const uint16_t* pieceRows, unsigned char nRows, int x, int y, unsigned char color){
+    /* Writes the piece into the field. The caller is responsible for
+     * checking the placement with collides() first */
+    for (unsigned char r = 0; r < nRows; r++){
+        RowMask mask;
+        if (pieceRows[r] == 0 || !shiftRow(pieceRows[r], x, mask))
+            continue;
+
+        int rf = y + r;
+        if (rf < 0 || rf >= rows())
+            continue;
+
+        mRows[rf] |= mask;
+        mRevision++;
+        for (unsigned char c = 0; c < cols(); c++)
+            if (mask & (1u << c)){
+                mColors[rf][c] = color;
+                if (rf < mColumnTops[c])
+                    mColumnTops[c] = rf;
+            }
+    }
+}
+
+template<class Dims>
+unsigned char BasicField<Dims>::flushFull(){
+    uint64_t clearedRows;
+    return flushFull(0, rows() - 1, clearedRows);
+}
+
+template<class Dims>
+unsigned char BasicField<Dims>::flushFull(int first, int last, uint64_t& clearedRows){
+    clearedRows = 0;
+    if (first < 0)
+        first = 0;
+    if (last >= rows())
+        last = rows() - 1;
+
+    unsigned char nFlushed = 0;
+    for (int r = first; r <= last; r++)
+        if (mRows[r] == fullRow()){
+            clearedRows |= 1ull << r;
+            nFlushed++;
+        }
+
+    if (nFlushed == 0)
+        return 0;
+
+    /* One bottom-up pass with a write cursor: the rows kept in the scanned
+     * range move down over the flushed ones, then everything above the range
+     * moves down by nFlushed rows at once */
+    int write = last;
+    for (int r = last; r >= first; r--){
+        if (clearedRows & (1ull << r))
+            continue;
+        if (write != r){
+            mRows[write] = mRows[r];
+            std::memcpy(mColors[write], mColors[r], sizeof(mColors[r]));
+        }
+        write--;
+    }
+
+    std::memmove(&mRows[nFlushed], &mRows[0], first * sizeof(mRows[0]));
+    std::memmove(&mColors[nFlushed], &mColors[0], first * sizeof(mColors[0]));
+    std::memset(mRows, 0, nFlushed * sizeof(mRows[0]));
+    std::memset(mColors, 0, nFlushed * sizeof(mColors[0]));
+    mRevision++;
+
+    /* Columns topped above the scanned range moved down with it. A column
+     * topped inside the range has no blocks above it, so its new top is the
+     * first block among the rows kept there */
+    for (unsigned char c = 0; c < cols(); c++){
+        if (mColumnTops[c] < first)
+            mColumnTops[c] += nFlushed;
+        else if (mColumnTops[c] <= last){
+            unsigned char top = first + nFlushed;
+            while (top < rows() && !(mRows[top] & (1u << c)))
+                top++;
+            mColumnTops[c] = top;
+        }
+    }
+
+    return nFlushed;
+}
+
+template<class Dims>
+bool BasicField<Dims>::addGarbage(unsigned char count, unsigned char hole, unsigned char color){
+    if (count == 0)
+        return true;
+    if (count > rows())
+        count = rows();
+
+    bool fits = true;
+    for (unsigned char r = 0; r < count; r++)
+        if (mRows[r] != 0)
+            fits = false;
+
+    unsigned char kept = rows() - count;
+    std::memmove(&mRows[0], &mRows[count], kept * sizeof(mRows[0]));
+    std::memmove(&mColors[0], &mColors[count], kept * sizeof(mColors[0]));
+
+    RowMask garbage = fullRow() & ~static_cast<RowMask>(1ull << (hole % cols()));
+    for (unsigned char r = kept; r < rows(); r++){
+        mRows[r] = garbage;
+        for (unsigned char c = 0; c < cols(); c++)
+            mColors[r][c] = (garbage & (1u << c)) ? color : 0;
+    }
+    mRevision++;
+
+    // Garbage is rare enough to find the column tops again from scratch
+    for (unsigned char c = 0; c < cols(); c++){
+        unsigned char top = 0;
+        while (top < rows() && !(mRows[top] & (1u << c)))
+            top++;
+        mColumnTops[c] = top;
+    }
+
+    return fits;
+}
+
+template<class Dims>
+void BasicField<Dims>::load(const unsigned char colors[][MAX_COLS]){
+    clear();
+
+    for (unsigned char r = 0; r < rows(); r++)
+        for (unsigned char c = 0; c < cols(); c++){
+            if (colors[r][c] == 0)
+                continue;
+
+            mColors[r][c] = colors[r][c];
+            mRows[r] |= 1u << c;
+            if (r < mColumnTops[c])
+                mColumnTops[c] = r;
+        }
+}
+
+template<class Dims>
+uint64_t BasicField<Dims>::hash() const{
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (unsigned char r = 0; r < rows(); r++){
+        for (unsigned int b = 0; b < sizeof(RowMask); b++)
+            h = (h ^ ((mRows[r] >> (8 * b)) & 0xFF)) * 0x100000001B3ull;
+        for (unsigned char c = 0; c < cols(); c++)
+            h = (h ^ mColors[r][c]) * 0x100000001B3ull;
+    }
+
+    return h;
+}
+
+template class BasicField<FixedDims<FIELD_ROWS, FIELD_COLS>>;
+template class BasicField<FixedDims<40, 10>>;
+template class BasicField<FixedDims<44, 20>>;
+template class BasicField<RuntimeDims>;
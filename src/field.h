@@ -0,0 +1,116 @@
+#ifndef TETRIS_FIELD_H
+#define TETRIS_FIELD_H
+
+#include <cstdint>
+#include <type_traits>
+
+const unsigned char FIELD_ROWS = 22;
+const unsigned char FIELD_COLS = 10;
+const uint16_t FULL_ROW = (1u << FIELD_COLS) - 1;
+
+// Rows above the visible field that pieces spawn in, never drawn
+const unsigned char FIELD_HIDDEN_ROWS = 2;
+
+/* Field dimensions known at compile time. Every loop over the rows or
+ * columns of such a field has constant bounds */
+template<unsigned char ROWS, unsigned char COLS>
+struct FixedDims {
+    static const unsigned char MAX_ROWS = ROWS;
+    static const unsigned char MAX_COLS = COLS;
+
+    constexpr unsigned char rows() const { return ROWS; }
+    constexpr unsigned char cols() const { return COLS; }
+};
+
+/* Field dimensions chosen at run time, for sizes without an instantiation
+ * of their own. Storage is always sized for the largest field */
+struct RuntimeDims {
+    static const unsigned char MAX_ROWS = 64;
+    static const unsigned char MAX_COLS = 32;
+
+    RuntimeDims(unsigned char rows = FIELD_ROWS, unsigned char cols = FIELD_COLS);
+
+    unsigned char rows() const { return mRows; }
+    unsigned char cols() const { return mCols; }
+
+    private:
+        unsigned char mRows;
+        unsigned char mCols;
+};
+
+/* Playing field stored as one occupancy bitmask per row (bit c is column c)
+ * plus a separate plane holding the block color of every cell. Collision,
+ * full row detection and line clears only touch the masks, the color plane
+ * is only read when rendering. Instantiated in field.cpp for the sizes
+ * typedef'd below */
+template<class Dims>
+class BasicField {
+    public:
+        // Smallest machine word that holds a row of the widest field
+        typedef typename std::conditional<Dims::MAX_COLS <= 16, uint16_t, uint32_t>::type RowMask;
+
+        static const unsigned char MAX_ROWS = Dims::MAX_ROWS;
+        static const unsigned char MAX_COLS = Dims::MAX_COLS;
+
+        static_assert(MAX_ROWS <= 64, "Cleared rows are returned as a 64-bit mask");
+        static_assert(MAX_COLS >= 4 && MAX_COLS <= 32, "Rows are stored as 32-bit masks at most");
+
+        explicit BasicField(Dims dims = Dims());
+
+        void clear();
+
+        unsigned char rows() const { return mDims.rows(); }
+        unsigned char cols() const { return mDims.cols(); }
+        RowMask fullRow() const { return static_cast<RowMask>((1ull << cols()) - 1); }
+
+        // Changes whenever blocks are added to or removed from the field
+        uint32_t revision() const { return mRevision; }
+
+        RowMask rowMask(unsigned char r) const { return mRows[r]; }
+        const RowMask* rowMasks() const { return mRows; }  // rows() contiguous masks, top row first
+
+        // Row of the highest block in a column, rows() for an empty column
+        unsigned char columnTop(unsigned char c) const { return mColumnTops[c]; }
+        unsigned char columnHeight(unsigned char c) const { return rows() - mColumnTops[c]; }
+        unsigned char get(unsigned char r, unsigned char c) const { return mColors[r][c]; }
+
+        // Piece rows are masks with the leftmost cell of the piece grid at bit 0
+        bool collides(const uint16_t* pieceRows, unsigned char nRows, int x, int y) const;
+        void lock(const uint16_t* pieceRows, unsigned char nRows, int x, int y, unsigned char color);
+
+        // Flushes all full rows in the field. Returns number of lines flushed
+        unsigned char flushFull();
+
+        /* Same, but only looks at rows first..last, which must include every
+         * row that can be full (the rows a piece was just locked into). Bit r
+         * of clearedRows is set for each flushed row r, numbered as before
+         * the flush */
+        unsigned char flushFull(int first, int last, uint64_t& clearedRows);
+
+        /* Pushes every row up by count rows and fills the bottom count rows
+         * with blocks of color, leaving column hole empty. Returns false if
+         * blocks were pushed off the top of the field */
+        bool addGarbage(unsigned char count, unsigned char hole, unsigned char color);
+
+        // Replaces the whole field, a color of 0 is an empty cell
+        void load(const unsigned char colors[][MAX_COLS]);
+
+        // 64-bit FNV-1a hash of the occupancy and colors of every cell
+        uint64_t hash() const;
+
+    private:
+        Dims mDims;
+        RowMask mRows[MAX_ROWS];
+        unsigned char mColors[MAX_ROWS][MAX_COLS];
+        unsigned char mColumnTops[MAX_COLS];  // Kept up to date by lock() and flushFull()
+        uint32_t mRevision;
+
+        bool shiftRow(uint16_t pieceRow, int x, RowMask& fieldRow) const;
+};
+
+typedef BasicField<FixedDims<FIELD_ROWS, FIELD_COLS>> Field;
+typedef BasicField<FixedDims<40, 10>> Field10x40;
+typedef BasicField<FixedDims<44, 20>> Field20x44;
+typedef BasicField<RuntimeDims> DynamicField;
+
+#endif
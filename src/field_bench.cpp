@@ -0,0 +1,219 @@
+#include <iostream>
+#include <vector>
+#include <stack>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+#include "field.h"
+#include "tetromino.h"
+
+/* Compares placements/sec of the bitboard Field against the original
+ * vector-of-vectors field. Both paths play the same sequence of pieces,
+ * rotations and columns: spawn, hard drop, lock, flush full rows, and
+ * reset the field whenever the stack tops out. */
+
+typedef std::vector<std::vector<unsigned char>> Grid;
+
+const std::vector<Grid> SHAPES = {
+    {{0, 1, 0}, {1, 1, 1}, {0, 0, 0}},
+    {{2, 2}, {2, 2}},
+    {{0, 3, 3}, {3, 3, 0}, {0, 0, 0}},
+    {{4, 4, 0}, {0, 4, 4}, {0, 0, 0}},
+    {{5, 5, 5}, {0, 0, 5}, {0, 0, 0}},
+    {{0, 0, 6}, {6, 6, 6}, {0, 0, 0}},
+    {{0, 0, 0, 0}, {7, 7, 7, 7}, {0, 0, 0, 0}, {0, 0, 0, 0}}
+};
+
+struct Placement {
+    unsigned char shape;
+    unsigned char rotation;
+    char x;
+};
+
+// Original field implementation, kept here as the baseline
+namespace legacy {
+
+struct Tetromino {
+    char x;
+    char y;
+    Grid shape;
+};
+
+bool collidesWith(const Tetromino& tetromino, const Grid& fieldMat){
+    unsigned int tSize = tetromino.shape.size();
+
+    for(unsigned char rt = 0; rt < tSize; rt++)
+        for(unsigned char ct = 0; ct < tSize; ct++){
+            if(tetromino.shape[rt][ct] == 0)
+                continue;
+
+            unsigned char rf = tetromino.y + rt;
+            unsigned char cf = tetromino.x + ct;
+
+            if (rf >= fieldMat.size())
+                return true;
+            if (cf >= fieldMat[0].size())
+                return true;
+
+            if(fieldMat[rf][cf] != 0)
+                return true;
+        }
+
+    return false;
+}
+
+void freezeTetromino(const Tetromino& tetromino, Grid& fieldMat){
+    for (unsigned char r = 0; r < tetromino.shape.size(); r++)
+        for (unsigned char c = 0; c < tetromino.shape[0].size(); c++){
+            if (tetromino.shape[r][c] == 0)
+                continue;
+            else
+                fieldMat[r + tetromino.y][c + tetromino.x] = tetromino.shape[r][c];
+        }
+}
+
+unsigned char flushFull(Grid& fieldMat){
+    unsigned char nFlushed = 0;
+    std::stack<unsigned char> flushStack;
+
+    for (unsigned int r = fieldMat.size() - 1; r > 0; r--){
+        bool rowFull = true;
+        for (unsigned int c = 0; c < fieldMat[0].size(); c++){
+            if (fieldMat[r][c] == 0){
+                rowFull = false;
+                break;
+            }
+        }
+
+        if (rowFull)
+            flushStack.push(r);
+    }
+
+    while(!flushStack.empty()){
+        for (unsigned char r = flushStack.top(); r > 0; r--)
+            for(unsigned char c = 0; c < fieldMat[0].size(); c++)
+                fieldMat[r][c] = fieldMat[r - 1][c];
+
+        flushStack.pop();
+        nFlushed++;
+    }
+
+    return nFlushed;
+}
+
+}
+
+Grid rotateGrid(const Grid& shape){
+    unsigned int tSize = shape.size();
+    Grid rotShape(tSize, std::vector<unsigned char>(tSize));
+
+    for(unsigned char r = 0; r < tSize; r++)
+        for(unsigned char c = 0; c < tSize; c++)
+            rotShape[r][c] = shape[tSize - 1 - c][r];
+
+    return rotShape;
+}
+
+unsigned long long runLegacy(const std::vector<Placement>& placements, const std::vector<std::vector<Grid>>& rotations){
+    Grid fieldMat(FIELD_ROWS, std::vector<unsigned char>(FIELD_COLS, 0));
+    unsigned long long lines = 0;
+
+    for (const Placement& p : placements){
+        legacy::Tetromino tetromino = {p.x, 0, rotations[p.shape][p.rotation]};
+
+        if (legacy::collidesWith(tetromino, fieldMat)){
+            fieldMat.assign(FIELD_ROWS, std::vector<unsigned char>(FIELD_COLS, 0));
+            continue;
+        }
+
+        // Hard drop
+        do {
+            tetromino.y++;
+        } while (!legacy::collidesWith(tetromino, fieldMat));
+        tetromino.y--;
+
+        legacy::freezeTetromino(tetromino, fieldMat);
+        lines += legacy::flushFull(fieldMat);
+
+        for (unsigned char c = 0; c < FIELD_COLS; c++)
+            if (fieldMat[1][c] > 0){
+                fieldMat.assign(FIELD_ROWS, std::vector<unsigned char>(FIELD_COLS, 0));
+                break;
+            }
+    }
+
+    return lines;
+}
+
+unsigned long long runBitboard(const std::vector<Placement>& placements){
+    Field field;
+    unsigned long long lines = 0;
+
+    for (const Placement& p : placements){
+        const ShapeInfo& shape = TETROMINO_TABLE[p.shape];
+        const uint16_t* rows = shape.rows[p.rotation];
+        int y = 0;
+
+        if (field.collides(rows, shape.size, p.x, y)){
+            field.clear();
+            continue;
+        }
+
+        // Hard drop
+        while (!field.collides(rows, shape.size, p.x, y + 1))
+            y++;
+
+        field.lock(rows, shape.size, p.x, y, shape.color);
+        lines += field.flushFull();
+
+        if (field.rowMask(FIELD_HIDDEN_ROWS - 1) != 0)
+            field.clear();
+    }
+
+    return lines;
+}
+
+int main(int argc, char* args[]){
+    unsigned int nPlacements = argc > 1 ? std::atoi(args[1]) : 2000000;
+
+    // Precompute all rotations of the original grids, the bitboard path uses TETROMINO_TABLE
+    std::vector<std::vector<Grid>> gridRotations;
+    for (const Grid& shape : SHAPES){
+        std::vector<Grid> grids(1, shape);
+        for (unsigned char i = 1; i < 4; i++)
+            grids.push_back(rotateGrid(grids.back()));
+
+        gridRotations.push_back(grids);
+    }
+
+    // Same random placement sequence for both paths
+    std::mt19937 rng(12345);
+    std::vector<Placement> placements(nPlacements);
+    for (Placement& p : placements){
+        p.shape = rng() % SHAPES.size();
+        p.rotation = rng() % 4;
+        p.x = rng() % (FIELD_COLS - 2);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    unsigned long long linesLegacy = runLegacy(placements, gridRotations);
+    auto t1 = std::chrono::steady_clock::now();
+    unsigned long long linesBitboard = runBitboard(placements);
+    auto t2 = std::chrono::steady_clock::now();
+
+    double secLegacy = std::chrono::duration<double>(t1 - t0).count();
+    double secBitboard = std::chrono::duration<double>(t2 - t1).count();
+
+    if (linesLegacy != linesBitboard){
+        std::cout << "Mismatch! legacy cleared " << linesLegacy << " lines, bitboard " << linesBitboard << "\n";
+        return 1;
+    }
+
+    std::cout << "Placements:     " << nPlacements << " (" << linesLegacy << " lines cleared)\n";
+    std::cout << "vector<vector>: " << nPlacements / secLegacy << " placements/s\n";
+    std::cout << "bitboard:       " << nPlacements / secBitboard << " placements/s\n";
+    std::cout << "speedup:        " << secLegacy / secBitboard << "x\n";
+
+    return 0;
+}
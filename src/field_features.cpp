@@ -0,0 +1,187 @@
+#include "field_features.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) && !defined(TETRIS_SCALAR_FEATURES)
+#include <emmintrin.h>
+#define TETRIS_SSE2_FEATURES
+#endif
+
+/* Aggregate height and bumpiness don't need the heights themselves. Once
+ * every cell below the top of its column is counted as covered, the
+ * aggregate height is the number of covered cells, and the bumpiness is
+ * the number of cells where exactly one of two neighbouring columns is
+ * covered */
+
+static void findHeights(const uint16_t* tops, uint64_t topRows, unsigned char nRows, FieldFeatures& features){
+    /* Every column has its top block in exactly one row. tops holds the
+     * columns topped in each row, topRows has a bit for each row that tops
+     * any column */
+    std::memset(features.heights, 0, sizeof(features.heights));
+    features.maxHeight = topRows != 0 ? nRows - __builtin_ctzll(topRows) : 0;
+
+    for (; topRows != 0; topRows &= topRows - 1){
+        unsigned char r = __builtin_ctzll(topRows);
+        for (unsigned int bits = tops[r]; bits != 0; bits &= bits - 1)
+            features.heights[__builtin_ctz(bits)] = nRows - r;
+    }
+}
+
+#ifdef TETRIS_SSE2_FEATURES
+
+static inline __m128i popcountBytes(__m128i v){
+    // Bit count of every byte, SSE2 has no popcount instruction
+    const __m128i m1 = _mm_set1_epi8(0x55);
+    const __m128i m2 = _mm_set1_epi8(0x33);
+    const __m128i m4 = _mm_set1_epi8(0x0F);
+    v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1));
+    v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+    return _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4);
+}
+
+static inline unsigned int sumBytes(__m128i v){
+    __m128i sums = _mm_sad_epu8(v, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+}
+
+// Row and column counts for the SIMD loop, see FixedDims for the standard field
+struct FeatureDims {
+    unsigned char nRows;
+    unsigned char nCols;
+
+    unsigned char rows() const { return nRows; }
+    unsigned char cols() const { return nCols; }
+};
+
+// Bit counts of each byte are summed in bytes, at most 16 per row group and 8 groups
+template<class Dims>
+static inline void computeSse2(const uint16_t* rows, Dims dims, FieldFeatures& features){
+    const unsigned char nRows = dims.rows();
+    const unsigned char nCols = dims.cols();
+
+    // Rows are padded to a multiple of 8, the padding is masked out of every count
+    alignas(16) uint16_t padded[MAX_FEATURE_ROWS];
+    alignas(16) uint16_t tops[MAX_FEATURE_ROWS];
+    unsigned char r = 0;
+    for (; r < nRows; r++)
+        padded[r] = rows[r];
+    for (; r & 7; r++)
+        padded[r] = 0;
+
+    const uint16_t fullMask = static_cast<uint16_t>((1u << nCols) - 1);
+    const __m128i full = _mm_set1_epi16(static_cast<short>(fullMask));
+    const __m128i interior = _mm_set1_epi16(static_cast<short>(fullMask >> 1));
+    const __m128i walls = _mm_set1_epi16(static_cast<short>(1u | (1u << (nCols - 1))));
+    const __m128i rowCount = _mm_set1_epi16(nRows);
+    __m128i laneRow = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m128i coveredAbove = _mm_setzero_si128();  // Every lane holds the OR of all rows processed so far
+    __m128i previous = _mm_setzero_si128();
+    __m128i covered = _mm_setzero_si128();
+    __m128i steps = _mm_setzero_si128();
+    __m128i holes = _mm_setzero_si128();
+    __m128i rowTransitions = _mm_setzero_si128();
+    __m128i columnTransitions = _mm_setzero_si128();
+    uint64_t fullRows = 0;
+    uint64_t topRows = 0;
+
+    for (r = 0; r < nRows; r += 8){
+        __m128i valid = _mm_cmplt_epi16(laneRow, rowCount);
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(padded + r));
+
+        __m128i isFull = _mm_and_si128(_mm_cmpeq_epi16(v, full), valid);
+        fullRows |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_packs_epi16(isFull, isFull)) & 0xFF) << r;
+
+        // Neighbouring cells that differ, plus empty cells next to a wall
+        __m128i inner = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi16(v, 1)), interior);
+        __m128i wall = _mm_andnot_si128(v, walls);
+        rowTransitions = _mm_add_epi8(rowTransitions, popcountBytes(_mm_and_si128(inner, valid)));
+        rowTransitions = _mm_add_epi8(rowTransitions, popcountBytes(_mm_and_si128(wall, valid)));
+
+        // Each row against the one above it
+        __m128i above = _mm_or_si128(_mm_slli_si128(v, 2), _mm_srli_si128(previous, 14));
+        columnTransitions = _mm_add_epi8(columnTransitions, popcountBytes(_mm_and_si128(_mm_xor_si128(v, above), valid)));
+        previous = v;
+
+        // Prefix OR down the lanes gives the covered cells of each row
+        __m128i cover = v;
+        cover = _mm_or_si128(cover, _mm_slli_si128(cover, 2));
+        cover = _mm_or_si128(cover, _mm_slli_si128(cover, 4));
+        cover = _mm_or_si128(cover, _mm_slli_si128(cover, 8));
+        cover = _mm_and_si128(_mm_or_si128(cover, coveredAbove), valid);
+        __m128i coverBefore = _mm_or_si128(_mm_slli_si128(cover, 2), coveredAbove);
+
+        covered = _mm_add_epi8(covered, popcountBytes(cover));
+        steps = _mm_add_epi8(steps, popcountBytes(_mm_and_si128(_mm_xor_si128(cover, _mm_srli_epi16(cover, 1)), interior)));
+
+        __m128i hole = _mm_and_si128(_mm_andnot_si128(v, coverBefore), full);
+        holes = _mm_add_epi8(holes, popcountBytes(_mm_and_si128(hole, valid)));
+
+        __m128i rowTops = _mm_andnot_si128(coverBefore, cover);
+        _mm_store_si128(reinterpret_cast<__m128i*>(tops + r), rowTops);
+        __m128i noTops = _mm_cmpeq_epi16(rowTops, _mm_setzero_si128());
+        topRows |= static_cast<uint64_t>(~_mm_movemask_epi8(_mm_packs_epi16(noTops, noTops)) & 0xFF) << r;
+
+        coveredAbove = _mm_shuffle_epi32(_mm_shufflehi_epi16(cover, 0xFF), 0xFF);
+        laneRow = _mm_add_epi16(laneRow, _mm_set1_epi16(8));
+    }
+
+    features.aggregateHeight = sumBytes(covered);
+    features.bumpiness = sumBytes(steps);
+    features.holes = sumBytes(holes);
+    features.rowTransitions = sumBytes(rowTransitions);
+    features.columnTransitions = sumBytes(columnTransitions) + __builtin_popcount(~rows[nRows - 1] & fullMask);
+    features.fullRows = fullRows;
+    findHeights(tops, topRows, nRows, features);
+}
+
+void computeFieldFeatures(const uint16_t* rows, unsigned char nRows, unsigned char nCols, FieldFeatures& features){
+    // The standard field gets constant bounds, so the row groups are unrolled
+    if (nRows == FIELD_ROWS && nCols == FIELD_COLS)
+        computeSse2(rows, FixedDims<FIELD_ROWS, FIELD_COLS>(), features);
+    else
+        computeSse2(rows, FeatureDims{nRows, nCols}, features);
+}
+
+#else
+
+void computeFieldFeatures(const uint16_t* rows, unsigned char nRows, unsigned char nCols, FieldFeatures& features){
+    uint16_t tops[MAX_FEATURE_ROWS];
+    const uint16_t fullMask = static_cast<uint16_t>((1u << nCols) - 1);
+    const uint16_t walls = static_cast<uint16_t>(1u | (1u << (nCols - 1)));
+
+    uint16_t cover = 0;
+    uint16_t previous = 0;
+    uint64_t topRows = 0;
+    features.aggregateHeight = 0;
+    features.bumpiness = 0;
+    features.holes = 0;
+    features.rowTransitions = 0;
+    features.columnTransitions = 0;
+    features.fullRows = 0;
+
+    for (unsigned char r = 0; r < nRows; r++){
+        uint16_t row = rows[r];
+        if (row == fullMask)
+            features.fullRows |= 1ull << r;
+
+        features.rowTransitions += __builtin_popcount((row ^ (row >> 1)) & (fullMask >> 1));
+        features.rowTransitions += __builtin_popcount(walls & ~row);
+        features.columnTransitions += __builtin_popcount(row ^ previous);
+        features.holes += __builtin_popcount(cover & ~row & fullMask);
+        previous = row;
+
+        tops[r] = row & ~cover;
+        if (tops[r] != 0)
+            topRows |= 1ull << r;
+
+        cover |= row;
+        features.aggregateHeight += __builtin_popcount(cover);
+        features.bumpiness += __builtin_popcount((cover ^ (cover >> 1)) & (fullMask >> 1));
+    }
+
+    features.columnTransitions += __builtin_popcount(~rows[nRows - 1] & fullMask);
+    findHeights(tops, topRows, nRows, features);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TETRIS_FIELD_FEATURES_H
+#define TETRIS_FIELD_FEATURES_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include "field.h"
+
+const unsigned char MAX_FEATURE_ROWS = 64;
+const unsigned char MAX_FEATURE_COLS = 16;
+
+/* Shape of the stack as seen by the bot and by analytics. Above the field
+ * counts as empty, the walls and the floor count as filled */
+struct FieldFeatures {
+    unsigned char heights[MAX_FEATURE_COLS];  // 0 for an empty column
+    unsigned int aggregateHeight;
+    unsigned int maxHeight;
+    unsigned int bumpiness;          // Sum of the height differences of neighbouring columns
+    unsigned int holes;              // Empty cells below the top block of their column
+    unsigned int rowTransitions;     // Empty/filled changes between horizontal neighbours
+    unsigned int columnTransitions;  // Empty/filled changes between vertical neighbours
+    uint64_t fullRows;               // Bit r is set for every full row
+};
+
+/* Computes all features in a single pass over nRows row bitmasks, top row
+ * first with bit c for column c. The rows are processed 8 at a time with
+ * SSE2 where the compiler targets it, otherwise one at a time */
+void computeFieldFeatures(const uint16_t* rows, unsigned char nRows, unsigned char nCols, FieldFeatures& features);
+
+template<class FieldT>
+FieldFeatures computeFieldFeatures(const FieldT& field){
+    static_assert(std::is_same<typename FieldT::RowMask, uint16_t>::value, "Features need 16-bit row masks");
+    static_assert(FieldT::MAX_ROWS <= MAX_FEATURE_ROWS, "Field too tall for the features");
+
+    FieldFeatures features;
+    computeFieldFeatures(field.rowMasks(), field.rows(), field.cols(), features);
+    return features;
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include "field_renderer.h"
+
+#include <cstdio>
+
+#include "trace.h"
+
+FieldRenderer::FieldRenderer(){
+    mRenderer = NULL;
+    mBlocks = NULL;
+    mFieldLayer = NULL;
+    mLayerValid = false;
+    mLayerRevision = 0;
+    mStageHook = NULL;
+}
+
+FieldRenderer::~FieldRenderer(){
+    free();
+}
+
+void FieldRenderer::init(SDL_Renderer* renderer, BlockBatch* blocks, bool retained){
+    free();
+    mRenderer = renderer;
+    mBlocks = blocks;
+
+    // Render targets are optional, not every renderer has them
+    if (!retained)
+        return;
+    if (!SDL_RenderTargetSupported(mRenderer)){
+        printf("Renderer has no render targets, rendering every frame in full\n");
+        return;
+    }
+
+    mFieldLayer = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (mFieldLayer == NULL)
+        printf("Could not create field layer, rendering every frame in full: %s\n", SDL_GetError());
+    else
+        SDL_SetTextureBlendMode(mFieldLayer, SDL_BLENDMODE_NONE);
+}
+
+void FieldRenderer::free(){
+    if (mFieldLayer != NULL){
+        SDL_DestroyTexture(mFieldLayer);
+        mFieldLayer = NULL;
+    }
+
+    mLayerValid = false;
+    mGhost = GhostCache();
+}
+
+void FieldRenderer::endStage(FrameStage stage){
+    if (mStageHook != NULL)
+        mStageHook(stage);
+}
+
+void FieldRenderer::renderFieldBlocks(const Field& fieldMat){
+    // Queues the locked blocks in FieldMat
+    TRACE_SCOPE("renderField");
+    for (unsigned int r = FIELD_HIDDEN_ROWS; r < fieldMat.rows(); r++){ // Don't render the hidden rows
+        if (fieldMat.rowMask(r) == 0)  // Nothing to draw in empty rows
+            continue;
+
+        for (unsigned int c = 0; c < fieldMat.cols(); c++){
+            unsigned char block = fieldMat.get(r, c);
+            if(block > 0)
+                mBlocks->addBlock(OFFSET_X + c * BLOCK_SIZE, OFFSET_Y + r * BLOCK_SIZE, block);
+        }
+    }
+}
+
+void FieldRenderer::renderPieces(const Field& fieldMat,
+        const Tetromino& tetromino, const Tetromino& nextTetromino){
+
+    // Queues the active tetromino, its ghost and the next tetromino
+    // Render active tetromino
+    if (tetromino.visible) {
+        unsigned int tSize = tetrominoSize(tetromino);
+        const uint16_t* rows = tetrominoRows(tetromino);
+        unsigned char color = tetrominoColor(tetromino);
+        for (unsigned int r = 0; r < tSize; r++) {
+
+            // Don't render the hidden rows
+            if (tetromino.y + r < FIELD_HIDDEN_ROWS)
+                continue;
+
+            for (unsigned int c = 0; c < tSize; c++)
+                if (rows[r] & (1u << c))
+                    mBlocks->addBlock(OFFSET_X + (tetromino.x + c) * BLOCK_SIZE, OFFSET_Y + (tetromino.y + r) * BLOCK_SIZE, color);
+        }
+    }
+
+
+    // Render ghost tetromino
+    Tetromino ghost = tetromino;
+    ghost.visible = true;
+    {
+        TRACE_SCOPE("ghost");
+        ghost.y = mGhost.landingRow(tetromino, fieldMat);
+    }
+
+    if (ghost.visible) {
+        unsigned int tSize = tetrominoSize(ghost);
+        const uint16_t* rows = tetrominoRows(ghost);
+        unsigned char color = tetrominoColor(ghost);
+        for (unsigned int r = 0; r < tSize; r++) {
+
+            // Don't render the hidden rows
+            if (ghost.y + r < FIELD_HIDDEN_ROWS)
+                continue;
+
+            for (unsigned int c = 0; c < tSize; c++)
+                if (rows[r] & (1u << c))
+                    mBlocks->addBlock(OFFSET_X + (ghost.x + c) * BLOCK_SIZE, OFFSET_Y + (ghost.y + r) * BLOCK_SIZE, color, true);
+        }
+    }
+
+
+    // Render next tetromino on the right
+    unsigned int tSize = tetrominoSize(nextTetromino);
+    const uint16_t* rows = tetrominoRows(nextTetromino);
+    unsigned char color = tetrominoColor(nextTetromino);
+    for (unsigned int r = 0; r < tSize; r++)
+        for (unsigned int c = 0; c < tSize; c++)
+            if(rows[r] & (1u << c))
+                mBlocks->addBlock(OFFSET_X_NEXT + c * BLOCK_SIZE, OFFSET_Y_NEXT + r * BLOCK_SIZE, color);
+}
+
+void FieldRenderer::renderBorder(const Field& fieldMat){
+    /* Draw the border of the playing field */
+    TRACE_SCOPE("renderBorder");
+
+    SDL_SetRenderDrawColor(mRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    int width = fieldMat.cols() * BLOCK_SIZE;
+    int height = (fieldMat.rows() - FIELD_HIDDEN_ROWS) * BLOCK_SIZE;  // Hidden rows are invisible
+    int border_offset_y = OFFSET_Y + BLOCK_SIZE * FIELD_HIDDEN_ROWS;
+
+    SDL_Rect borders[4] = {
+        {OFFSET_X-5, border_offset_y, 5, height},                                 // Left
+        {static_cast<int>(OFFSET_X) + width, border_offset_y, 5, height + 5},     // Right
+        {OFFSET_X-5, border_offset_y -5, width + 10, 5},                          // Top
+        {OFFSET_X-5, border_offset_y + height, width + 5, 5}                      // Bottom
+    };
+    SDL_RenderFillRects(mRenderer, borders, 4);
+}
+
+void FieldRenderer::updateFieldLayer(const Field& fieldMat){
+    /* Redraws the background, border and locked blocks into the field layer */
+    SDL_SetRenderTarget(mRenderer, mFieldLayer);
+
+    SDL_SetRenderDrawColor(mRenderer, 0x00, 0x00, 0x00, 0xFF);
+    SDL_RenderClear(mRenderer);
+
+    renderBorder(fieldMat);
+    endStage(STAGE_BORDER);
+
+    renderFieldBlocks(fieldMat);
+    mBlocks->flush();
+
+    SDL_SetRenderTarget(mRenderer, NULL);
+    endStage(STAGE_FIELD);
+}
+
+unsigned int FieldRenderer::draw(const Field& fieldMat, const Tetromino& tetromino, const Tetromino& nextTetromino){
+    unsigned int otherDrawCalls = 0;
+
+    if (mFieldLayer != NULL){
+        if (!mLayerValid || mLayerRevision != fieldMat.revision()){
+            updateFieldLayer(fieldMat);
+            mLayerValid = true;
+            mLayerRevision = fieldMat.revision();
+            otherDrawCalls += 2;  // Clear and border
+        }
+
+        // The opaque layer replaces clearing the screen
+        SDL_RenderCopy(mRenderer, mFieldLayer, NULL, NULL);
+        otherDrawCalls++;
+        endStage(STAGE_FIELD);
+    }
+    else {
+        SDL_SetRenderDrawColor(mRenderer, 0x00, 0x00, 0x00, 0xFF);
+        SDL_RenderClear(mRenderer);
+        renderBorder(fieldMat);
+        endStage(STAGE_BORDER);
+        renderFieldBlocks(fieldMat);
+        endStage(STAGE_FIELD);
+        otherDrawCalls += 2;
+    }
+
+    renderPieces(fieldMat, tetromino, nextTetromino);
+    mBlocks->flush();
+    endStage(STAGE_PIECES);
+
+    return otherDrawCalls;
+}
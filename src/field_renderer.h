@@ -0,0 +1,96 @@
+#ifndef TETRIS_FIELD_RENDERER_H
+#define TETRIS_FIELD_RENDERER_H
+
+#include <cstdint>
+#include <SDL2/SDL.h>
+
+#include "block_batch.h"
+#include "frame_telemetry.h"
+#include "game.h"
+
+// Window layout of the single player game, in pixels
+const int SCREEN_WIDTH = 800;
+const int SCREEN_HEIGHT = 600;
+const unsigned char BLOCK_SIZE = 28;
+const int OFFSET_X = 40;
+const int OFFSET_Y = -40;
+const int OFFSET_X_NEXT = SCREEN_WIDTH / 2 - 50;
+const int OFFSET_Y_NEXT = 50;
+
+/* Landing row of the active tetromino. Only recomputed when the piece
+ * changes column, shape or rotation, or the field changes. Falling
+ * further down the same column doesn't change where it lands */
+class GhostCache {
+    public:
+        char landingRow(const Tetromino& tetromino, const Field& fieldMat){
+            if (!mValid || tetromino.x != mX || tetromino.shape != mShape || tetromino.rotation != mRotation
+                    || fieldMat.revision() != mFieldRevision || tetromino.y > mLandingRow){
+                mX = tetromino.x;
+                mShape = tetromino.shape;
+                mRotation = tetromino.rotation;
+                mFieldRevision = fieldMat.revision();
+                mLandingRow = dropRow(tetromino, fieldMat);
+                mValid = true;
+            }
+
+            return mLandingRow;
+        }
+
+    private:
+        bool mValid = false;
+        char mX = 0;
+        unsigned char mShape = 0;
+        unsigned char mRotation = 0;
+        uint32_t mFieldRevision = 0;
+        char mLandingRow = 0;
+};
+
+// Called when a part of the frame is drawn, with the stage its time belongs to
+typedef void (*FrameStageHook)(FrameStage stage);
+
+/* Draws the field area of a single player frame: background, border,
+ * locked blocks, the active tetromino with its ghost and the next one.
+ * With the retained field layer, background, border and locked blocks
+ * are drawn into a texture only when the field changes, and every frame
+ * copies that texture instead of clearing the screen. Shared by the game
+ * and tetris-bench, so the bench times the path the game draws with */
+class FieldRenderer {
+    public:
+        FieldRenderer();
+        ~FieldRenderer();
+
+        FieldRenderer(const FieldRenderer&) = delete;
+        FieldRenderer& operator=(const FieldRenderer&) = delete;
+
+        /* blocks must be initialized on renderer. retained asks for the
+         * field layer, without render target support every frame is drawn
+         * in full instead */
+        void init(SDL_Renderer* renderer, BlockBatch* blocks, bool retained);
+        void free();
+
+        bool retained() const { return mFieldLayer != NULL; }
+        void setStageHook(FrameStageHook hook) { mStageHook = hook; }
+
+        // Redraws the field layer on the next frame even if the field is unchanged
+        void invalidate() { mLayerValid = false; }
+
+        // Draws and flushes the blocks. Returns the draw calls made outside of the block batch
+        unsigned int draw(const Field& fieldMat, const Tetromino& tetromino, const Tetromino& nextTetromino);
+
+    private:
+        SDL_Renderer* mRenderer;
+        BlockBatch* mBlocks;
+        SDL_Texture* mFieldLayer;
+        bool mLayerValid;
+        uint32_t mLayerRevision;
+        GhostCache mGhost;
+        FrameStageHook mStageHook;
+
+        void endStage(FrameStage stage);
+        void renderBorder(const Field& fieldMat);
+        void renderFieldBlocks(const Field& fieldMat);
+        void renderPieces(const Field& fieldMat, const Tetromino& tetromino, const Tetromino& nextTetromino);
+        void updateFieldLayer(const Field& fieldMat);
+};
+
+#endif
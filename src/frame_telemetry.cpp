@@ -0,0 +1,141 @@
+#include "frame_telemetry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+const char* frameStageName(FrameStage stage){
+    static const char* const names[NUM_FRAME_STAGES] = {
+        "input", "logic", "border", "field", "pieces", "text", "present"
+    };
+    return stage < NUM_FRAME_STAGES ? names[stage] : "unknown";
+}
+
+FrameHistory::FrameHistory(){
+    clear();
+}
+
+void FrameHistory::clear(){
+    mNext = 0;
+    mCount = 0;
+}
+
+void FrameHistory::add(const FrameSample& sample){
+    mSamples[mNext] = sample;
+    mNext = (mNext + 1) % SIZE;
+    if (mCount < SIZE)
+        mCount++;
+}
+
+FrameSummary FrameHistory::summarize() const{
+    FrameSummary summary = {};
+    summary.frames = mCount;
+    if (mCount == 0)
+        return summary;
+
+    // Frames in the window are unordered here, which doesn't matter for any of the statistics
+    uint32_t intervals[SIZE];
+    uint64_t stageTotals[NUM_FRAME_STAGES] = {};
+    uint64_t drawCalls = 0;
+    uint64_t allocations = 0;
+    for (unsigned int i = 0; i < mCount; i++){
+        const FrameSample& sample = mSamples[i];
+        intervals[i] = sample.interval;
+        for (int s = 0; s < NUM_FRAME_STAGES; s++)
+            stageTotals[s] += sample.stages[s];
+        drawCalls += sample.drawCalls;
+        allocations += sample.allocations;
+    }
+
+    // Nearest rank, the smallest interval at least p percent of the frames don't exceed
+    unsigned int p50 = (mCount * 50 + 99) / 100 - 1;
+    unsigned int p99 = (mCount * 99 + 99) / 100 - 1;
+    std::nth_element(intervals, intervals + p99, intervals + mCount);
+    summary.intervalP99 = intervals[p99];
+    summary.intervalMax = *std::max_element(intervals + p99, intervals + mCount);
+    std::nth_element(intervals, intervals + p50, intervals + p99);
+    summary.intervalP50 = intervals[p50];
+
+    for (int s = 0; s < NUM_FRAME_STAGES; s++)
+        summary.stageMean[s] = static_cast<double>(stageTotals[s]) / mCount;
+    summary.drawCalls = static_cast<double>(drawCalls) / mCount;
+    summary.allocations = static_cast<double>(allocations) / mCount;
+    return summary;
+}
+
+TelemetryWriter::TelemetryWriter(){
+    mJson = false;
+    mUsed = 0;
+}
+
+TelemetryWriter::~TelemetryWriter(){
+    close();
+}
+
+bool TelemetryWriter::open(const char* path){
+    close();
+
+    size_t length = std::strlen(path);
+    mJson = length >= 5 && std::strcmp(path + length - 5, ".json") == 0;
+    if (!mFile.open(path))
+        return false;
+
+    // JSON lines need no header, every object names its fields
+    if (!mJson){
+        mUsed = std::snprintf(mBuffer, MAX_LINE_SIZE, "frame,time_us,interval_us");
+        for (int s = 0; s < NUM_FRAME_STAGES; s++)
+            mUsed += std::snprintf(mBuffer + mUsed, MAX_LINE_SIZE - mUsed, ",%s_us", frameStageName(static_cast<FrameStage>(s)));
+        mUsed += std::snprintf(mBuffer + mUsed, MAX_LINE_SIZE - mUsed, ",logic_steps,draw_calls,allocations\n");
+    }
+
+    return true;
+}
+
+void TelemetryWriter::write(const FrameSample& sample){
+    if (!isOpen())
+        return;
+
+    // The longest line, a JSON object with every number at its widest, is under 350 bytes
+    char* line = mBuffer + mUsed;
+    int size = 0;
+    if (mJson){
+        size += std::snprintf(line, MAX_LINE_SIZE, "{\"frame\":%llu,\"time_us\":%llu,\"interval_us\":%u",
+                static_cast<unsigned long long>(sample.frame), static_cast<unsigned long long>(sample.time), sample.interval);
+        for (int s = 0; s < NUM_FRAME_STAGES; s++)
+            size += std::snprintf(line + size, MAX_LINE_SIZE - size, ",\"%s_us\":%u",
+                    frameStageName(static_cast<FrameStage>(s)), sample.stages[s]);
+        size += std::snprintf(line + size, MAX_LINE_SIZE - size, ",\"logic_steps\":%u,\"draw_calls\":%u,\"allocations\":%u}\n",
+                sample.logicSteps, sample.drawCalls, sample.allocations);
+    }
+    else {
+        size += std::snprintf(line, MAX_LINE_SIZE, "%llu,%llu,%u",
+                static_cast<unsigned long long>(sample.frame), static_cast<unsigned long long>(sample.time), sample.interval);
+        for (int s = 0; s < NUM_FRAME_STAGES; s++)
+            size += std::snprintf(line + size, MAX_LINE_SIZE - size, ",%u", sample.stages[s]);
+        size += std::snprintf(line + size, MAX_LINE_SIZE - size, ",%u,%u,%u\n",
+                sample.logicSteps, sample.drawCalls, sample.allocations);
+    }
+
+    mUsed += size;
+    if (mUsed >= FLUSH_SIZE)
+        flush();
+}
+
+void TelemetryWriter::flush(){
+    mFile.write(mBuffer, mUsed);
+    mUsed = 0;
+}
+
+bool TelemetryWriter::close(){
+    if (!isOpen())
+        return true;
+
+    flush();
+    std::string path = mFile.path();
+    if (!mFile.close()){
+        printf("Could not write telemetry %s!\n", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef TETRIS_FRAME_TELEMETRY_H
+#define TETRIS_FRAME_TELEMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "async_writer.h"
+
+// Parts of a frame timed separately, in the order the game loop runs them
+enum FrameStage {
+    STAGE_INPUT,
+    STAGE_LOGIC,
+    STAGE_BORDER,   // Clearing and the border
+    STAGE_FIELD,    // Locked blocks, or copying the cached field layer
+    STAGE_PIECES,   // Active, ghost and next piece
+    STAGE_TEXT,     // Score and the performance overlay
+    STAGE_PRESENT,  // Includes waiting for vsync
+    NUM_FRAME_STAGES
+};
+
+const char* frameStageName(FrameStage stage);
+
+/* Everything measured for one presented frame, times in microseconds.
+ * Input and logic of loop iterations that skipped drawing are counted in
+ * the next frame that is drawn */
+struct FrameSample {
+    uint64_t frame;     // Frames presented before this one
+    uint64_t time;      // Since telemetry started, taken after presenting
+    uint32_t interval;  // Since the previous frame was presented
+    uint32_t stages[NUM_FRAME_STAGES];
+    uint32_t logicSteps;
+    uint32_t drawCalls;
+    uint32_t allocations;  // On any thread since the previous frame was presented
+};
+
+// What the performance overlay shows
+struct FrameSummary {
+    unsigned int frames;
+    uint32_t intervalP50;
+    uint32_t intervalP99;
+    uint32_t intervalMax;
+    double stageMean[NUM_FRAME_STAGES];
+    double drawCalls;
+    double allocations;
+};
+
+/* The most recent frames, kept in a fixed ring so recording a frame and
+ * summarizing the window never allocate */
+class FrameHistory {
+    public:
+        static const unsigned int SIZE = 512;
+
+        FrameHistory();
+
+        void add(const FrameSample& sample);
+        void clear();
+
+        // Percentiles are nearest rank over the frames in the window
+        FrameSummary summarize() const;
+
+    private:
+        FrameSample mSamples[SIZE];
+        unsigned int mNext;
+        unsigned int mCount;
+};
+
+/* Streams frame samples to a file, as CSV or, for a path ending in .json,
+ * one JSON object per line. Lines are formatted into a fixed buffer and
+ * handed to an AsyncFileWriter a few kilobytes at a time, so the render
+ * thread never touches the file */
+class TelemetryWriter {
+    public:
+        TelemetryWriter();
+        ~TelemetryWriter();
+
+        TelemetryWriter(const TelemetryWriter&) = delete;
+        TelemetryWriter& operator=(const TelemetryWriter&) = delete;
+
+        bool open(const char* path);
+        void write(const FrameSample& sample);
+
+        // Writes the lines still buffered, then closes the file, false if the file could not be written completely
+        bool close();
+
+        bool isOpen() const { return mFile.isOpen(); }
+
+    private:
+        static const size_t FLUSH_SIZE = 2048;
+        static const size_t MAX_LINE_SIZE = 512;
+
+        AsyncFileWriter mFile;
+        bool mJson;
+        char mBuffer[FLUSH_SIZE + MAX_LINE_SIZE];
+        size_t mUsed;
+
+        void flush();
+};
+
+#endif
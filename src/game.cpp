@@ -0,0 +1,290 @@
+#include "game.h"
+
+#include "trace.h"
+
+template<class FieldT>
+bool collidesWith(const Tetromino& tetromino, const FieldT& fieldMat){
+    // Checks if a tetromino collides with the field or the boundaries of the field
+    return fieldMat.collides(tetrominoRows(tetromino), tetrominoSize(tetromino), tetromino.x, tetromino.y);
+}
+
+template<class FieldT>
+bool move(Tetromino& tetromino, const FieldT& fieldMat, const char direction){
+    /* Attempts to move the tetromino 1 step in provided direction.
+     * Returns true if move is successful, or false if the move is
+     * impossible due to a collision. */
+
+    // Move the piece
+    switch(direction){
+        case DIR_UP:
+            tetromino.y--;
+            break;
+        case DIR_DOWN:
+            tetromino.y++;
+            break;
+        case DIR_LEFT:
+            tetromino.x--;
+            break;
+        case DIR_RIGHT:
+            tetromino.x++;
+            break;
+    }
+
+    // Cancel the move on collision
+    if(collidesWith(tetromino, fieldMat)){
+        switch(direction){
+            case DIR_UP:
+                tetromino.y++;
+                break;
+            case DIR_DOWN:
+                tetromino.y--;
+                break;
+            case DIR_LEFT:
+                tetromino.x++;
+                break;
+            case DIR_RIGHT:
+                tetromino.x--;
+                break;
+        }
+
+        return false;
+    }
+    else
+        return true;
+}
+
+template<class FieldT>
+bool rotate(Tetromino& tetromino, const FieldT& fieldMat){
+    /* Attemps to rotate the tetromino by 90 degrees. Returns true
+     * if the rotation is successful, or false if the rotation is
+     * impossible due to a collision */
+    unsigned char oldRotation = tetromino.rotation;  // Keep old rotation in case rotation fails
+
+	/* Check rotated tetromino for collisions, try kicks if necessary*/
+    tetromino.rotation = (tetromino.rotation + 1) & 3;
+    if(collidesWith(tetromino, fieldMat)){
+		tetromino.x++; // Attempt right kick
+		if(collidesWith(tetromino, fieldMat)){
+			tetromino.x -= 2;  // Attempt left kick
+			if (collidesWith(tetromino, fieldMat)) {
+				tetromino.x++;
+		        tetromino.rotation = oldRotation;
+				return false;  // Rotation failed
+
+			}
+		}
+    }
+
+	return true;
+}
+
+template<class FieldT>
+char dropRow(const Tetromino& tetromino, const FieldT& fieldMat){
+    /* Returns the row the tetromino comes to rest on when dropped straight
+     * down. When every column of the piece is above the stack this is read
+     * off the column tops, otherwise the piece is moved down step by step */
+    const signed char* bottoms = tetrominoBottoms(tetromino);
+    int landing = fieldMat.rows();
+
+    for (unsigned char c = 0; c < 4; c++){
+        if (bottoms[c] < 0)  // Empty column of the piece
+            continue;
+
+        int col = tetromino.x + c;
+        int lowest = tetromino.y + bottoms[c];
+        if (col < 0 || col >= fieldMat.cols() || lowest >= fieldMat.columnTop(col)){
+            // Tucked under an overhang (or out of bounds), take the slow path
+            Tetromino dropped = tetromino;
+            while (move(dropped, fieldMat, DIR_DOWN));
+            return dropped.y;
+        }
+
+        int rest = fieldMat.columnTop(col) - 1 - bottoms[c];
+        if (rest < landing)
+            landing = rest;
+    }
+
+    return landing;
+}
+
+template<class FieldT>
+void freezeTetromino(const Tetromino& tetromino, FieldT& fieldMat){
+    /* Locks the tetromino into place then spawns a new one */
+    fieldMat.lock(tetrominoRows(tetromino), tetrominoSize(tetromino), tetromino.x, tetromino.y, tetrominoColor(tetromino));
+}
+
+template<class FieldT>
+unsigned char flushFull(const Tetromino& tetromino, FieldT& fieldMat, uint64_t& clearedRows){
+    /* Flushes the full rows after the tetromino was frozen. Only the rows it
+     * covers can have become full. Returns number of lines flushed*/
+    return fieldMat.flushFull(tetromino.y, tetromino.y + tetrominoSize(tetromino) - 1, clearedRows);
+}
+
+template<class FieldT>
+BasicGameState<FieldT>::BasicGameState(uint64_t seed, PieceMode pieceMode, const FieldT& emptyField)
+        : mField(emptyField), mPieces(seed, pieceMode){
+    reset();
+    mNext = { spawnX(mField), SPAWN_Y, true, mPieces.next(), 0 };
+}
+
+template<class FieldT>
+void BasicGameState<FieldT>::reset(){
+    /* Starts a new game on an empty field. The piece sequence continues
+     * from where the previous game left off */
+    mField.clear();
+    mActive = { spawnX(mField), SPAWN_Y, true, mPieces.next(), 0 };
+
+    mScore = 0;
+    mPlacedCount = 0;
+    mGameOver = false;
+    mTickTimer = 0;
+    mMaxTickTime = START_TICK_TIME;
+}
+
+template<class FieldT>
+BasicGameSnapshot<FieldT> BasicGameState<FieldT>::snapshot() const{
+    BasicGameSnapshot<FieldT> snapshot;
+    for (unsigned char r = 0; r < mField.rows(); r++)
+        for (unsigned char c = 0; c < mField.cols(); c++)
+            snapshot.colors[r][c] = mField.get(r, c);
+
+    snapshot.active = mActive;
+    snapshot.nextShape = mNext.shape;
+    snapshot.score = mScore;
+    snapshot.placedCount = mPlacedCount;
+    snapshot.tickTimer = mTickTimer;
+    snapshot.maxTickTime = mMaxTickTime;
+    snapshot.gameOver = mGameOver;
+    snapshot.pieces = mPieces.saveState();
+
+    return snapshot;
+}
+
+template<class FieldT>
+void BasicGameState<FieldT>::restore(const BasicGameSnapshot<FieldT>& snapshot){
+    mField.load(snapshot.colors);
+
+    mActive = snapshot.active;
+    mNext = { spawnX(mField), SPAWN_Y, true, snapshot.nextShape, 0 };
+    mScore = snapshot.score;
+    mPlacedCount = snapshot.placedCount;
+    mTickTimer = snapshot.tickTimer;
+    mMaxTickTime = snapshot.maxTickTime;
+    mGameOver = snapshot.gameOver;
+    mPieces.restoreState(snapshot.pieces);
+}
+
+template<class FieldT>
+int BasicGameState<FieldT>::endTurn(StepResult& result){
+    /* Ends current turn. Returns points scored in this turn, or returns -1 on gameOver */
+    TRACE_SCOPE("endTurn");
+
+    // Freeze tetromino and flush
+    freezeTetromino(mActive, mField);
+    unsigned char nFlushed;
+    {
+        // Traced here rather than in flushFull itself, which the bot calls for every leaf
+        TRACE_SCOPE("flushFull");
+        nFlushed = flushFull(mActive, mField, result.clearedRows);
+    }
+
+    result.locked = true;
+    result.linesCleared = nFlushed;
+    mPlacedCount++;
+
+	// Game over if player tops out
+	if (mField.rowMask(FIELD_HIDDEN_ROWS - 1) != 0) {
+		mActive.visible = false;
+		return -1;
+	}
+
+	// Copy shape of next tetromino to the active one
+    mActive.x = spawnX(mField);
+    mActive.y = SPAWN_Y;
+    mActive.shape = mNext.shape;
+    mActive.rotation = 0;
+
+	// Obtain next tetromino
+	mNext.shape = mPieces.next();
+
+	// Game over if the tetromino can't be placed
+	if (collidesWith(mActive, mField))
+		return -1;
+
+    int turnScore = (nFlushed * nFlushed) * 100;
+
+    return turnScore;
+}
+
+template<class FieldT>
+void BasicGameState<FieldT>::addGarbage(unsigned char count, unsigned char hole, unsigned char color){
+    if (mGameOver || count == 0)
+        return;
+
+    bool fits = mField.addGarbage(count, hole, color);
+    if (!fits || mField.rowMask(FIELD_HIDDEN_ROWS - 1) != 0 || collidesWith(mActive, mField)){
+        mActive.visible = false;
+        mGameOver = true;
+    }
+}
+
+template<class FieldT>
+StepResult BasicGameState<FieldT>::step(const GameInput& input, uint32_t elapsedMs){
+    /* Applies the player input, then advances the game clock by elapsedMs
+     * and runs a logic tick when it is due */
+    StepResult result;
+
+    if (mGameOver){
+        result.gameOver = true;
+        return result;
+    }
+
+    bool forceTick = false;
+
+    if (input.direction == DIR_LEFT || input.direction == DIR_RIGHT || input.direction == DIR_DOWN)
+        move(mActive, mField, input.direction);
+
+    if (input.rotate)
+        rotate(mActive, mField);
+
+    if (input.drop){
+        mActive.y = dropRow(mActive, mField);
+        forceTick = true;
+    }
+
+    // Game logic tick
+    mTickTimer += elapsedMs;
+    if (mTickTimer > mMaxTickTime || forceTick){
+        mTickTimer = 0;
+
+        // Try to move tetromino down, end turn if blocked
+        if(!move(mActive, mField, DIR_DOWN)){
+            int turnScore = endTurn(result);
+            if(turnScore == -1)
+                mGameOver = true;
+            else{
+                // Gradually speed up the game after every clear, lower cap at 50ms
+                if (turnScore > 0 && mMaxTickTime > 25)
+                    mMaxTickTime -= 10;
+                mScore += turnScore;
+            }
+        }
+    }
+
+    result.gameOver = mGameOver;
+    return result;
+}
+
+#define INSTANTIATE_GAME(FieldT) \
+    template bool collidesWith(const Tetromino&, const FieldT&); \
+    template bool move(Tetromino&, const FieldT&, const char); \
+    template bool rotate(Tetromino&, const FieldT&); \
+    template char dropRow(const Tetromino&, const FieldT&); \
+    template void freezeTetromino(const Tetromino&, FieldT&); \
+    template unsigned char flushFull(const Tetromino&, FieldT&, uint64_t&); \
+    template class BasicGameState<FieldT>;
+
+INSTANTIATE_GAME(Field)
+INSTANTIATE_GAME(Field10x40)
+INSTANTIATE_GAME(Field20x44)
+INSTANTIATE_GAME(DynamicField)
@@ -0,0 +1,116 @@
+#ifndef TETRIS_GAME_H
+#define TETRIS_GAME_H
+
+#include <cstdint>
+
+#include "field.h"
+#include "piece_generator.h"
+#include "tetromino.h"
+
+enum Direction {
+    DIR_NONE, DIR_UP, DIR_DOWN, DIR_LEFT, DIR_RIGHT
+};
+
+const char SPAWN_Y = 0;
+const uint32_t START_TICK_TIME = 1000;  // Starting speed is 1 tick/s
+
+// Spawn column of new tetrominoes, 4 on the standard field
+template<class FieldT>
+char spawnX(const FieldT& fieldMat) { return fieldMat.cols() / 2 - 1; }
+
+/* The game logic works on any field type from field.h, game.cpp
+ * instantiates it for each of them */
+template<class FieldT>
+bool collidesWith(const Tetromino& tetromino, const FieldT& fieldMat);
+template<class FieldT>
+bool move(Tetromino& tetromino, const FieldT& fieldMat, const char direction);
+template<class FieldT>
+bool rotate(Tetromino& tetromino, const FieldT& fieldMat);
+template<class FieldT>
+char dropRow(const Tetromino& tetromino, const FieldT& fieldMat);
+template<class FieldT>
+void freezeTetromino(const Tetromino& tetromino, FieldT& fieldMat);
+template<class FieldT>
+unsigned char flushFull(const Tetromino& tetromino, FieldT& fieldMat, uint64_t& clearedRows);
+
+// Player actions for one step, already debounced by the caller
+struct GameInput {
+    Direction direction = DIR_NONE;
+    bool rotate = false;
+    bool drop = false;
+};
+
+// What happened during one step
+struct StepResult {
+    bool locked = false;              // Active tetromino was frozen into the field
+    unsigned char linesCleared = 0;
+    uint64_t clearedRows = 0;         // Bit r is set for each cleared row, numbered as before the clear
+    bool gameOver = false;
+};
+
+// Everything needed to continue a game exactly where it was
+template<class FieldT>
+struct BasicGameSnapshot {
+    unsigned char colors[FieldT::MAX_ROWS][FieldT::MAX_COLS];
+    Tetromino active;
+    unsigned char nextShape;
+
+    uint32_t score;
+    uint32_t placedCount;
+    uint32_t tickTimer;
+    uint32_t maxTickTime;
+    bool gameOver;
+
+    PieceGenerator::State pieces;
+};
+
+typedef BasicGameSnapshot<Field> GameSnapshot;
+
+/* Complete state of a single game, without any dependency on SDL. The
+ * game only advances through step(), which makes it deterministic for a
+ * given seed and sequence of inputs and elapsed times */
+template<class FieldT>
+class BasicGameState {
+    public:
+        // emptyField sets the size of the board when it is only known at run time
+        BasicGameState(uint64_t seed, PieceMode pieceMode = PIECES_BAG7, const FieldT& emptyField = FieldT());
+
+        void reset();
+        StepResult step(const GameInput& input, uint32_t elapsedMs);
+
+        const FieldT& field() const { return mField; }
+        const Tetromino& activeTetromino() const { return mActive; }
+        const Tetromino& nextTetromino() const { return mNext; }
+        uint32_t score() const { return mScore; }
+        bool isGameOver() const { return mGameOver; }
+        uint64_t seed() const { return mPieces.seed(); }
+        uint32_t placedCount() const { return mPlacedCount; }
+
+        /* Raises the field by count garbage rows with column hole left
+         * empty. The game is over if that pushes blocks off the field or
+         * into the hidden rows, or leaves no room for the active tetromino */
+        void addGarbage(unsigned char count, unsigned char hole, unsigned char color);
+
+        // restore() expects a game created with the same seed and piece mode
+        BasicGameSnapshot<FieldT> snapshot() const;
+        void restore(const BasicGameSnapshot<FieldT>& snapshot);
+
+    private:
+        FieldT mField;
+        Tetromino mActive;
+        Tetromino mNext;
+
+        uint32_t mScore;
+        uint32_t mPlacedCount;  // Tetrominoes locked this game
+        bool mGameOver;
+        uint32_t mTickTimer;    // Time since the last logic tick
+        uint32_t mMaxTickTime;
+
+        PieceGenerator mPieces;
+
+        int endTurn(StepResult& result);
+};
+
+typedef BasicGameState<Field> GameState;
+
+#endif
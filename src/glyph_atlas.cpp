@@ -0,0 +1,150 @@
+#include "glyph_atlas.h"
+
+#include <cstdio>
+
+GlyphAtlas::GlyphAtlas(){
+    mRenderer = NULL;
+    mAtlas = NULL;
+    mAtlasWidth = 0;
+    mAtlasHeight = 0;
+    mDrawCalls = 0;
+}
+
+GlyphAtlas::~GlyphAtlas(){
+    free();
+}
+
+void GlyphAtlas::free(){
+    if (mAtlas != NULL){
+        SDL_DestroyTexture(mAtlas);
+        mAtlas = NULL;
+    }
+}
+
+bool GlyphAtlas::init(SDL_Renderer* renderer, TTF_Font* font){
+    /* Renders every glyph in white, side by side in one row. Text color
+     * is applied per vertex when drawing */
+    free();
+    mRenderer = renderer;
+
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    SDL_Surface* glyphSurfaces[NUM_GLYPHS];
+
+    mAtlasWidth = 0;
+    mAtlasHeight = TTF_FontHeight(font);
+    for (unsigned int i = 0; i < NUM_GLYPHS; i++){
+        Uint16 ch = FIRST_GLYPH + i;
+
+        glyphSurfaces[i] = TTF_RenderGlyph_Blended(font, ch, white);
+        if (glyphSurfaces[i] == NULL){
+            printf("Unable to render glyph '%c'! SDL_ttf Error: %s\n", ch, TTF_GetError());
+            for (unsigned int j = 0; j < i; j++)
+                SDL_FreeSurface(glyphSurfaces[j]);
+            return false;
+        }
+
+        int minX, maxX, minY, maxY, advance;
+        if (TTF_GlyphMetrics(font, ch, &minX, &maxX, &minY, &maxY, &advance) != 0)
+            advance = glyphSurfaces[i]->w;
+
+        mGlyphs[i].src = {mAtlasWidth, 0, glyphSurfaces[i]->w, glyphSurfaces[i]->h};
+        mGlyphs[i].advance = advance;
+
+        mAtlasWidth += glyphSurfaces[i]->w;
+        if (glyphSurfaces[i]->h > mAtlasHeight)
+            mAtlasHeight = glyphSurfaces[i]->h;
+    }
+
+    SDL_Surface* atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, mAtlasWidth, mAtlasHeight, 32, SDL_PIXELFORMAT_RGBA32);
+    if (atlasSurface == NULL){
+        printf("Could not create glyph atlas surface! SDL Error: %s\n", SDL_GetError());
+        for (unsigned int i = 0; i < NUM_GLYPHS; i++)
+            SDL_FreeSurface(glyphSurfaces[i]);
+        return false;
+    }
+
+    // Copy the glyphs including their alpha instead of blending them onto the atlas
+    for (unsigned int i = 0; i < NUM_GLYPHS; i++){
+        SDL_Rect dst = mGlyphs[i].src;
+        SDL_SetSurfaceBlendMode(glyphSurfaces[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(glyphSurfaces[i], NULL, atlasSurface, &dst);
+        SDL_FreeSurface(glyphSurfaces[i]);
+    }
+
+    mAtlas = SDL_CreateTextureFromSurface(renderer, atlasSurface);
+    SDL_FreeSurface(atlasSurface);
+
+    if (mAtlas == NULL){
+        printf("Could not create glyph atlas texture! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(mAtlas, SDL_BLENDMODE_BLEND);
+
+    mVertices.reserve(4 * MAX_TEXT_GLYPHS);
+    mIndices.reserve(6 * MAX_TEXT_GLYPHS);
+
+    return true;
+}
+
+void GlyphAtlas::addText(const char* text, int x, int y, SDL_Color color){
+    for (const char* ch = text; *ch != '\0'; ch++){
+        if (*ch < FIRST_GLYPH || *ch > LAST_GLYPH)
+            continue;
+
+        if (mVertices.size() >= 4 * MAX_TEXT_GLYPHS)
+            flush();
+
+        const Glyph& glyph = mGlyphs[*ch - FIRST_GLYPH];
+
+        float x0 = x;
+        float y0 = y;
+        float x1 = x + glyph.src.w;
+        float y1 = y + glyph.src.h;
+
+        float u0 = static_cast<float>(glyph.src.x) / mAtlasWidth;
+        float u1 = static_cast<float>(glyph.src.x + glyph.src.w) / mAtlasWidth;
+        float v1 = static_cast<float>(glyph.src.h) / mAtlasHeight;
+
+        int first = mVertices.size();
+        mVertices.push_back({{x0, y0}, color, {u0, 0}});
+        mVertices.push_back({{x1, y0}, color, {u1, 0}});
+        mVertices.push_back({{x1, y1}, color, {u1, v1}});
+        mVertices.push_back({{x0, y1}, color, {u0, v1}});
+
+        const int quad[6] = {0, 1, 2, 0, 2, 3};
+        for (int i : quad)
+            mIndices.push_back(first + i);
+
+        x += glyph.advance;
+    }
+}
+
+void GlyphAtlas::flush(){
+    /* Submits all queued text. Falls back to one copy per glyph on SDL
+     * versions without SDL_RenderGeometry */
+    if (mVertices.empty())
+        return;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_RenderGeometry(mRenderer, mAtlas, mVertices.data(), mVertices.size(), mIndices.data(), mIndices.size());
+    mDrawCalls++;
+#else
+    for (size_t v = 0; v < mVertices.size(); v += 4){
+        const SDL_Vertex& topLeft = mVertices[v];
+        const SDL_Vertex& bottomRight = mVertices[v + 2];
+
+        SDL_Rect src = {static_cast<int>(topLeft.tex_coord.x * mAtlasWidth + 0.5f), 0,
+            static_cast<int>((bottomRight.tex_coord.x - topLeft.tex_coord.x) * mAtlasWidth + 0.5f),
+            static_cast<int>(bottomRight.tex_coord.y * mAtlasHeight + 0.5f)};
+        SDL_Rect dst = {static_cast<int>(topLeft.position.x), static_cast<int>(topLeft.position.y), src.w, src.h};
+
+        SDL_SetTextureColorMod(mAtlas, topLeft.color.r, topLeft.color.g, topLeft.color.b);
+        SDL_SetTextureAlphaMod(mAtlas, topLeft.color.a);
+        SDL_RenderCopy(mRenderer, mAtlas, &src, &dst);
+        mDrawCalls++;
+    }
+#endif
+
+    mVertices.clear();
+    mIndices.clear();
+}
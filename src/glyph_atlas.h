@@ -0,0 +1,48 @@
+#ifndef TETRIS_GLYPH_ATLAS_H
+#define TETRIS_GLYPH_ATLAS_H
+
+#include <vector>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+const char FIRST_GLYPH = ' ';
+const char LAST_GLYPH = '~';
+const unsigned int NUM_GLYPHS = LAST_GLYPH - FIRST_GLYPH + 1;
+const unsigned int MAX_TEXT_GLYPHS = 256;  // Glyphs queued before the text flushes itself
+
+/* Printable ASCII rasterized once into a single texture. Strings are
+ * drawn as one textured quad per glyph, so drawing text every frame
+ * never renders surfaces or creates textures */
+class GlyphAtlas {
+    public:
+        GlyphAtlas();
+        ~GlyphAtlas();
+
+        bool init(SDL_Renderer* renderer, TTF_Font* font);
+        void free();
+
+        // Queues the text, characters outside the atlas are skipped
+        void addText(const char* text, int x, int y, SDL_Color color);
+        void flush();
+
+        unsigned int drawCalls() const { return mDrawCalls; }
+        void resetDrawCalls() { mDrawCalls = 0; }
+
+    private:
+        struct Glyph {
+            SDL_Rect src;  // Location in the atlas
+            int advance;
+        };
+
+        SDL_Renderer* mRenderer;
+        SDL_Texture* mAtlas;
+        int mAtlasWidth;
+        int mAtlasHeight;
+        Glyph mGlyphs[NUM_GLYPHS];
+
+        std::vector<SDL_Vertex> mVertices;
+        std::vector<int> mIndices;
+        unsigned int mDrawCalls;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "input.h"
+
+static const Direction ACTION_DIRECTIONS[3] = {DIR_LEFT, DIR_RIGHT, DIR_DOWN};
+
+static bool isDirection(unsigned char action){
+    return action == INPUT_LEFT || action == INPUT_RIGHT || action == INPUT_DOWN;
+}
+
+InputDecoder::InputDecoder(const InputTiming& timing){
+    mTiming = timing;
+    mDas = timing.das * 1000ull;
+    mArr = timing.arr * 1000ull;
+    mHoldRepeat = timing.holdRepeat * 1000ull;
+    reset();
+}
+
+void InputDecoder::reset(){
+    for (unsigned char a = 0; a < NUM_INPUT_ACTIONS; a++){
+        mHeld[a] = false;
+        mNextRepeat[a] = 0;
+    }
+
+    mTapHead = 0;
+    mTapCount = 0;
+    mRotatePresses = 0;
+    mDropPresses = 0;
+    mRepeatAction = NUM_INPUT_ACTIONS;
+}
+
+void InputDecoder::apply(const InputEvent& event){
+    unsigned char a = event.action;
+    if (a >= NUM_INPUT_ACTIONS)
+        return;
+
+    if (!event.pressed){
+        mHeld[a] = false;
+        if (mRepeatAction == a)
+            mRepeatAction = NUM_INPUT_ACTIONS;
+        return;
+    }
+
+    // Presses of a key that is already down are auto-repeat from the OS, repeating is done here
+    if (mHeld[a])
+        return;
+    mHeld[a] = true;
+
+    if (isDirection(a)){
+        if (mTapCount < MAX_TAPS){
+            mTaps[(mTapHead + mTapCount) % MAX_TAPS] = ACTION_DIRECTIONS[a];
+            mTapCount++;
+        }
+        mRepeatAction = a;
+        mNextRepeat[a] = event.time + mDas;
+    }
+    else {
+        if (a == INPUT_ROTATE)
+            mRotatePresses++;
+        else
+            mDropPresses++;
+        mNextRepeat[a] = event.time + mHoldRepeat;
+    }
+}
+
+bool InputDecoder::canApply(const InputEvent& event) const{
+    // Only a new direction press needs room, in the tap ring
+    unsigned char a = event.action;
+    return mTapCount < MAX_TAPS || !event.pressed || a >= NUM_INPUT_ACTIONS || !isDirection(a) || mHeld[a];
+}
+
+bool InputDecoder::repeatDue(unsigned char action, uint64_t interval, uint64_t stepEnd){
+    /* Fires a held action once its repeat time has passed. A repeat that
+     * fell behind by several intervals still fires only once, so holding
+     * a key never queues up a burst of moves */
+    if (!mHeld[action] || mNextRepeat[action] > stepEnd)
+        return false;
+
+    mNextRepeat[action] += interval;
+    if (mNextRepeat[action] <= stepEnd)
+        mNextRepeat[action] = stepEnd + 1;
+    return true;
+}
+
+GameInput InputDecoder::step(InputQueue& queue, uint64_t stepEnd){
+    InputEvent event;
+    while (queue.front(event) && event.time <= stepEnd && canApply(event)){
+        queue.pop(event);
+        apply(event);
+    }
+
+    return step(stepEnd);
+}
+
+GameInput InputDecoder::step(uint64_t stepEnd){
+    GameInput input;
+
+    if (mTapCount > 0){
+        input.direction = mTaps[mTapHead];
+        mTapHead = (mTapHead + 1) % MAX_TAPS;
+        mTapCount--;
+    }
+    else if (mRepeatAction != NUM_INPUT_ACTIONS && repeatDue(mRepeatAction, mArr, stepEnd))
+        input.direction = ACTION_DIRECTIONS[mRepeatAction];
+
+    if (mRotatePresses > 0){
+        input.rotate = true;
+        mRotatePresses--;
+    }
+    else if (mHoldRepeat > 0)
+        input.rotate = repeatDue(INPUT_ROTATE, mHoldRepeat, stepEnd);
+
+    if (mDropPresses > 0){
+        input.drop = true;
+        mDropPresses--;
+    }
+    else if (mHoldRepeat > 0)
+        input.drop = repeatDue(INPUT_DROP, mHoldRepeat, stepEnd);
+
+    return input;
+}
@@ -0,0 +1,83 @@
+#ifndef TETRIS_INPUT_H
+#define TETRIS_INPUT_H
+
+#include <cstdint>
+
+#include "game.h"
+#include "spsc_ring.h"
+
+enum InputAction : unsigned char {
+    INPUT_LEFT, INPUT_RIGHT, INPUT_DOWN, INPUT_ROTATE, INPUT_DROP, NUM_INPUT_ACTIONS
+};
+
+/* A press or release of one action, timestamped in microseconds when it
+ * was captured. The game captures events when it pumps them once per
+ * frame, so its timestamps have frame resolution */
+struct InputEvent {
+    uint64_t time;
+    unsigned char action;
+    bool pressed;
+};
+
+const size_t INPUT_QUEUE_SIZE = 256;
+typedef SpscRing<InputEvent, INPUT_QUEUE_SIZE> InputQueue;
+
+/* Repeat timing in milliseconds. Held directions move once on the press,
+ * again after das and then every arr. Held rotate and drop repeat every
+ * holdRepeat, 0 turns repeating off. An arr of 0 moves on every step */
+struct InputTiming {
+    uint32_t das = 100;
+    uint32_t arr = 100;
+    uint32_t holdRepeat = 200;
+};
+
+/* Turns timestamped press and release events into one GameInput per logic
+ * step. Every press produces its action even if it was released before the
+ * step it belongs to ran, presses that land in the same step are carried
+ * over to the following steps. Repeats are timed from the event timestamps
+ * rather than from when the events were read */
+class InputDecoder {
+    public:
+        InputDecoder(const InputTiming& timing = InputTiming());
+
+        void reset();
+
+        /* Events must be applied in timestamp order. A direction press is
+         * lost when MAX_TAPS of them are still waiting, canApply() tells */
+        void apply(const InputEvent& event);
+        bool canApply(const InputEvent& event) const;
+
+        /* Applies the queued events up to stepEnd, then builds the input of
+         * the step ending there. Events stay queued while the presses
+         * before them fill up the decoder, later steps take them */
+        GameInput step(InputQueue& queue, uint64_t stepEnd);
+        GameInput step(uint64_t stepEnd);
+
+        const InputTiming& timing() const { return mTiming; }
+
+    private:
+        static const unsigned int MAX_TAPS = 16;
+
+        uint64_t mDas;
+        uint64_t mArr;
+        uint64_t mHoldRepeat;
+        InputTiming mTiming;
+
+        bool mHeld[NUM_INPUT_ACTIONS];
+        uint64_t mNextRepeat[NUM_INPUT_ACTIONS];
+
+        // Direction presses not yet turned into a move, oldest first
+        Direction mTaps[MAX_TAPS];
+        unsigned int mTapHead;
+        unsigned int mTapCount;
+
+        unsigned int mRotatePresses;
+        unsigned int mDropPresses;
+
+        // Held direction that repeats, the most recently pressed one
+        unsigned char mRepeatAction;
+
+        bool repeatDue(unsigned char action, uint64_t interval, uint64_t stepEnd);
+};
+
+#endif
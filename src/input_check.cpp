@@ -0,0 +1,221 @@
+#include <iostream>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+
+#include "input.h"
+
+/* Replays synthetic input streams through the input queue and decoder and
+ * checks what comes out of the logic steps. The tap stream is produced on
+ * a second thread, like a real input source, and uses presses far shorter
+ * than a logic step, every one of them has to show up as an action. The
+ * bursts press more directions in one step than the decoder holds at
+ * once, the hold streams check the DAS/ARR repeat counts.
+ *
+ * Usage: input-check [presses] [step ms] [seed] */
+
+struct ActionCounts {
+    unsigned long long counts[NUM_INPUT_ACTIONS] = {};
+};
+
+void countInput(const GameInput& input, ActionCounts& out){
+    if (input.direction == DIR_LEFT)
+        out.counts[INPUT_LEFT]++;
+    else if (input.direction == DIR_RIGHT)
+        out.counts[INPUT_RIGHT]++;
+    else if (input.direction == DIR_DOWN)
+        out.counts[INPUT_DOWN]++;
+
+    if (input.rotate)
+        out.counts[INPUT_ROTATE]++;
+    if (input.drop)
+        out.counts[INPUT_DROP]++;
+}
+
+bool checkTaps(unsigned int nPresses, uint32_t stepMs, uint64_t seed){
+    // Repeats are turned off, so every action must come out exactly once per press
+    InputTiming timing;
+    timing.das = 1000000;
+    timing.arr = 1000000;
+    timing.holdRepeat = 0;
+
+    InputQueue queue;
+    InputDecoder decoder(timing);
+    ActionCounts pressed;
+    ActionCounts produced;
+
+    std::atomic<uint64_t> producedUntil(0);
+    std::atomic<bool> producing(true);
+
+    std::thread producer([&]{
+        std::mt19937_64 rng(seed);
+        uint64_t time = 0;
+        for (unsigned int i = 0; i < nPresses; i++){
+            unsigned char action = rng() % NUM_INPUT_ACTIONS;
+
+            // Presses from 50 us up to two steps long, with gaps of up to two steps
+            uint64_t down = time + rng() % (2000 * stepMs);
+            uint64_t up = down + 50 + rng() % (2000 * stepMs);
+
+            InputEvent press = {down, action, true};
+            InputEvent release = {up, action, false};
+            while (!queue.push(press))
+                std::this_thread::yield();
+            while (!queue.push(release))
+                std::this_thread::yield();
+
+            pressed.counts[action]++;
+            time = up;
+            producedUntil.store(time, std::memory_order_release);
+        }
+        producing.store(false, std::memory_order_release);
+    });
+
+    // Only run a step once everything up to its end time was produced, as if steps ran in real time
+    uint64_t stepEnd = 0;
+    for (;;){
+        bool done = !producing.load(std::memory_order_acquire);
+        if (!done && producedUntil.load(std::memory_order_acquire) < stepEnd + stepMs * 1000ull){
+            std::this_thread::yield();
+            continue;
+        }
+
+        stepEnd += stepMs * 1000ull;
+        GameInput input = decoder.step(queue, stepEnd);
+        countInput(input, produced);
+
+        // Keep stepping after the last event until the carried over presses are out
+        if (done && queue.empty() && input.direction == DIR_NONE && !input.rotate && !input.drop)
+            break;
+    }
+    producer.join();
+
+    const char* names[NUM_INPUT_ACTIONS] = {"left", "right", "down", "rotate", "drop"};
+    bool ok = true;
+    for (unsigned char a = 0; a < NUM_INPUT_ACTIONS; a++){
+        std::cout << "  " << names[a] << ": " << pressed.counts[a] << " pressed, " << produced.counts[a] << " produced\n";
+        if (pressed.counts[a] != produced.counts[a])
+            ok = false;
+    }
+
+    return ok;
+}
+
+bool checkBurst(unsigned int nPresses, uint32_t stepMs){
+    /* Presses and releases directions nPresses times within the first
+     * step, more than the decoder holds at once. The rest wait in the
+     * queue, and every press still comes out as one move */
+    InputTiming timing;
+    timing.das = 1000000;
+    timing.arr = 1000000;
+
+    InputDecoder decoder(timing);
+    InputQueue queue;
+    ActionCounts pressed;
+    ActionCounts produced;
+
+    const uint64_t stepMicros = stepMs * 1000ull;
+    for (unsigned int i = 0; i < nPresses; i++){
+        unsigned char action = static_cast<unsigned char>(i % 3);  // Left, right and down
+        uint64_t down = i * stepMicros / (2 * nPresses);
+        if (!queue.push({down, action, true}) || !queue.push({down + 1, action, false})){
+            std::cout << "  Queue too small for " << nPresses << " presses\n";
+            return false;
+        }
+        pressed.counts[action]++;
+    }
+
+    uint64_t stepEnd = 0;
+    for (unsigned int s = 0; s < 2 * nPresses + 2; s++){
+        stepEnd += stepMicros;
+        countInput(decoder.step(queue, stepEnd), produced);
+    }
+
+    bool ok = queue.empty();
+    for (unsigned char a = INPUT_LEFT; a <= INPUT_DOWN; a++)
+        ok = ok && produced.counts[a] == pressed.counts[a];
+
+    std::cout << "  " << nPresses << " presses in one step: "
+        << produced.counts[INPUT_LEFT] + produced.counts[INPUT_RIGHT] + produced.counts[INPUT_DOWN] << " moves\n";
+    return ok;
+}
+
+bool checkHold(uint32_t das, uint32_t arr, uint32_t holdMs, uint32_t stepMs){
+    /* Holds right for holdMs, starting halfway through a step. Expects the
+     * press, the first repeat after das and one more every arr, or every
+     * step for an arr of 0. A repeat fires in the first step ending at or
+     * after its due time, at most one per step. The release is applied
+     * before the step it lands in runs, so a repeat due in that step never
+     * fires */
+    InputTiming timing;
+    timing.das = das;
+    timing.arr = arr;
+
+    InputDecoder decoder(timing);
+    ActionCounts produced;
+
+    uint64_t down = stepMs * 500ull;
+    uint64_t up = down + holdMs * 1000ull;
+    decoder.apply({down, INPUT_RIGHT, true});
+
+    uint64_t stepEnd = 0;
+    bool released = false;
+    while (stepEnd < up + 2 * stepMs * 1000ull){
+        stepEnd += stepMs * 1000ull;
+        if (!released && up <= stepEnd){
+            decoder.apply({up, INPUT_RIGHT, false});
+            released = true;
+        }
+        countInput(decoder.step(stepEnd), produced);
+    }
+
+    // The first step after the press produces the press itself, repeats start with the next one
+    const uint64_t stepMicros = stepMs * 1000ull;
+    unsigned long long expected = 1;
+    uint64_t due = down + das * 1000ull;
+    for (uint64_t end = 2 * stepMicros; end < up; end += stepMicros){
+        if (due > end)
+            continue;
+
+        expected++;
+        due += arr * 1000ull;
+        if (due <= end)
+            due = end + 1;
+    }
+
+    unsigned long long got = produced.counts[INPUT_RIGHT];
+    std::cout << "  das " << das << " arr " << arr << " hold " << holdMs << " ms: "
+        << got << " moves, expected " << expected << "\n";
+
+    return got == expected;
+}
+
+int main(int argc, char* args[]){
+    unsigned int nPresses = argc > 1 ? std::atoi(args[1]) : 1000000;
+    uint32_t stepMs = argc > 2 ? std::atoi(args[2]) : 5;
+    uint64_t seed = argc > 3 ? std::strtoull(args[3], NULL, 10) : 1;
+    if (stepMs == 0)
+        stepMs = 1;
+
+    bool ok = true;
+
+    std::cout << "Taps:\n";
+    ok = checkTaps(nPresses, stepMs, seed) && ok;
+
+    std::cout << "Bursts:\n";
+    ok = checkBurst(40, stepMs) && ok;
+
+    std::cout << "Holds:\n";
+    ok = checkHold(100, 100, 50, stepMs) && ok;
+    ok = checkHold(100, 100, 1000, stepMs) && ok;
+    ok = checkHold(170, 50, 1000, stepMs) && ok;
+    ok = checkHold(133, 0, 500, stepMs) && ok;
+
+    // A repeat due in the release step, and the same one due a step earlier
+    ok = checkHold(100, 100, 300, stepMs) && ok;
+    ok = checkHold(100, 100, 300 + stepMs, stepMs) && ok;
+
+    std::cout << (ok ? "OK" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
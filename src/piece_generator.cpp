@@ -0,0 +1,168 @@
+#include "piece_generator.h"
+
+#include <cassert>
+
+static inline uint64_t rotl(uint64_t x, int k){
+    return (x << k) | (x >> (64 - k));
+}
+
+PieceGenerator::PieceGenerator(uint64_t seed, PieceMode mode) : mMode(mode){
+    reseed(seed);
+}
+
+void PieceGenerator::reseed(uint64_t seed){
+    /* Restarts the sequence from the beginning */
+    mSeed = seed;
+
+    uint64_t sm = seed;
+    for (unsigned char i = 0; i < 4; i++)
+        mState[i] = splitMix64(sm);
+
+    mBagLeft = 0;
+    mQueueHead = 0;
+    mQueueSize = 0;
+}
+
+uint64_t PieceGenerator::nextRandom(){
+    // xoshiro256**
+    uint64_t result = rotl(mState[1] * 5, 7) * 9;
+    uint64_t t = mState[1] << 17;
+
+    mState[2] ^= mState[0];
+    mState[3] ^= mState[1];
+    mState[1] ^= mState[2];
+    mState[0] ^= mState[3];
+    mState[2] ^= t;
+    mState[3] = rotl(mState[3], 45);
+
+    return result;
+}
+
+unsigned int PieceGenerator::bounded(unsigned int n){
+    /* Uniform value in [0, n) by multiply-shift, rejecting the few values
+     * that would bias the result */
+    uint32_t x = nextRandom() >> 32;
+    uint64_t m = static_cast<uint64_t>(x) * n;
+    uint32_t low = static_cast<uint32_t>(m);
+
+    if (low < n){
+        uint32_t threshold = -n % n;
+        while (low < threshold){
+            x = nextRandom() >> 32;
+            m = static_cast<uint64_t>(x) * n;
+            low = static_cast<uint32_t>(m);
+        }
+    }
+
+    return m >> 32;
+}
+
+void PieceGenerator::refillBag(){
+    // Fisher-Yates shuffle of all shapes
+    for (unsigned char i = 0; i < NUM_SHAPES; i++)
+        mBag[i] = i;
+
+    for (unsigned char i = NUM_SHAPES - 1; i > 0; i--){
+        unsigned int j = bounded(i + 1);
+        unsigned char tmp = mBag[i];
+        mBag[i] = mBag[j];
+        mBag[j] = tmp;
+    }
+
+    mBagLeft = NUM_SHAPES;
+}
+
+unsigned char PieceGenerator::draw(){
+    /* Produces the next piece of the sequence, bypassing the peek queue */
+    if (mMode == PIECES_RANDOM)
+        return bounded(NUM_SHAPES);
+
+    if (mBagLeft == 0)
+        refillBag();
+
+    return mBag[--mBagLeft];
+}
+
+unsigned char PieceGenerator::next(){
+    if (mQueueSize == 0)
+        return draw();
+
+    unsigned char piece = mQueue[mQueueHead];
+    mQueueHead = (mQueueHead + 1) % MAX_PEEK;
+    mQueueSize--;
+
+    return piece;
+}
+
+unsigned char PieceGenerator::peek(unsigned int ahead){
+    // The queue holds MAX_PEEK pieces, release builds peek as far as it reaches
+    assert(ahead < MAX_PEEK);
+    if (ahead >= MAX_PEEK)
+        ahead = MAX_PEEK - 1;
+
+    // Draw pieces into the queue until the requested one is known
+    while (mQueueSize <= ahead){
+        mQueue[(mQueueHead + mQueueSize) % MAX_PEEK] = draw();
+        mQueueSize++;
+    }
+
+    return mQueue[(mQueueHead + ahead) % MAX_PEEK];
+}
+
+void PieceGenerator::generate(unsigned char* out, size_t n){
+    size_t i = 0;
+
+    // Pieces that were already peeked come first
+    for (; i < n && mQueueSize > 0; i++)
+        out[i] = next();
+
+    if (mMode == PIECES_RANDOM){
+        for (; i < n; i++)
+            out[i] = bounded(NUM_SHAPES);
+        return;
+    }
+
+    // Rest of the current bag, then whole bags straight into the buffer
+    for (; i < n && mBagLeft > 0; i++)
+        out[i] = mBag[--mBagLeft];
+
+    for (; i + NUM_SHAPES <= n; i += NUM_SHAPES){
+        refillBag();
+        for (unsigned char j = 0; j < NUM_SHAPES; j++)
+            out[i + j] = mBag[NUM_SHAPES - 1 - j];
+        mBagLeft = 0;
+    }
+
+    for (; i < n; i++)
+        out[i] = draw();
+}
+
+PieceGenerator::State PieceGenerator::saveState() const{
+    State state;
+    for (unsigned char i = 0; i < 4; i++)
+        state.random[i] = mState[i];
+    for (unsigned char i = 0; i < NUM_SHAPES; i++)
+        state.bag[i] = mBag[i];
+    state.bagLeft = mBagLeft;
+
+    state.queueSize = mQueueSize;
+    for (unsigned int i = 0; i < MAX_PEEK; i++)
+        state.queue[i] = i < mQueueSize ? mQueue[(mQueueHead + i) % MAX_PEEK] : 0;
+
+    return state;
+}
+
+void PieceGenerator::restoreState(const State& state){
+    /* Continues the sequence from a saved position. Seed and mode stay
+     * the ones this generator was created with */
+    for (unsigned char i = 0; i < 4; i++)
+        mState[i] = state.random[i];
+    for (unsigned char i = 0; i < NUM_SHAPES; i++)
+        mBag[i] = state.bag[i];
+    mBagLeft = state.bagLeft < NUM_SHAPES ? state.bagLeft : static_cast<unsigned char>(NUM_SHAPES);
+
+    mQueueHead = 0;
+    mQueueSize = state.queueSize < MAX_PEEK ? state.queueSize : MAX_PEEK;
+    for (unsigned int i = 0; i < mQueueSize; i++)
+        mQueue[i] = state.queue[i];
+}
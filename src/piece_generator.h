@@ -0,0 +1,71 @@
+#ifndef TETRIS_PIECE_GENERATOR_H
+#define TETRIS_PIECE_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tetromino.h"
+
+enum PieceMode {
+    PIECES_BAG7,    // Every 7 pieces contain each shape exactly once
+    PIECES_RANDOM   // Every piece is drawn independently
+};
+
+inline uint64_t splitMix64(uint64_t& state){
+    // Expands a single 64-bit value into well mixed generator state
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Reproducible sequence of shape IDs for one game, driven by xoshiro256**.
+ * The same seed and mode always produce the same sequence. Upcoming pieces
+ * are kept in a small fixed queue so they can be peeked without allocating */
+class PieceGenerator {
+    public:
+        static const unsigned int MAX_PEEK = 32;
+
+        // Position in the sequence, enough to continue it exactly from there
+        struct State {
+            uint64_t random[4];
+            unsigned char bag[NUM_SHAPES];
+            unsigned char bagLeft;
+            unsigned char queueSize;
+            unsigned char queue[MAX_PEEK];  // Peeked pieces, oldest first
+        };
+
+        PieceGenerator(uint64_t seed, PieceMode mode = PIECES_BAG7);
+
+        void reseed(uint64_t seed);
+        uint64_t seed() const { return mSeed; }
+        PieceMode mode() const { return mMode; }
+
+        unsigned char next();
+        unsigned char peek(unsigned int ahead = 0);  // ahead < MAX_PEEK, larger values peek MAX_PEEK - 1
+
+        // Takes the next n pieces of the sequence and writes them to out
+        void generate(unsigned char* out, size_t n);
+
+        State saveState() const;
+        void restoreState(const State& state);
+
+    private:
+        uint64_t mSeed;
+        PieceMode mMode;
+        uint64_t mState[4];
+
+        unsigned char mBag[NUM_SHAPES];
+        unsigned char mBagLeft;
+
+        unsigned char mQueue[MAX_PEEK];
+        unsigned int mQueueHead;
+        unsigned int mQueueSize;
+
+        uint64_t nextRandom();
+        unsigned int bounded(unsigned int n);
+        void refillBag();
+        unsigned char draw();
+};
+
+#endif
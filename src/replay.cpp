@@ -0,0 +1,270 @@
+#include "replay.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static const unsigned char REPLAY_MAGIC[4] = {'T', 'R', 'P', 'L'};
+
+unsigned char encodeInput(const GameInput& input){
+    return static_cast<unsigned char>(input.direction) | (input.rotate ? 0x08 : 0) | (input.drop ? 0x10 : 0);
+}
+
+GameInput decodeInput(unsigned char bits){
+    GameInput input;
+    input.direction = static_cast<Direction>(bits & 0x07);
+    input.rotate = (bits & 0x08) != 0;
+    input.drop = (bits & 0x10) != 0;
+    return input;
+}
+
+ReplayEncoder::ReplayEncoder(){
+    mEmptySteps = 0;
+    mFinished = true;
+}
+
+void ReplayEncoder::begin(const ReplayHeader& header){
+    mBytes.clear();
+    for (unsigned char ch : REPLAY_MAGIC)
+        mBytes.push_back(ch);
+    mBytes.push_back(REPLAY_VERSION);
+    mBytes.push_back(static_cast<unsigned char>(header.pieceMode));
+    putLE(mBytes, header.stepMs, 2);
+    putLE(mBytes, header.seed, 8);
+
+    mEmptySteps = 0;
+    mFinished = false;
+}
+
+void ReplayEncoder::putVarint(uint64_t value){
+    // 7 bits per byte, low bits first, the high bit marks that more bytes follow
+    while (value >= 0x80){
+        mBytes.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    mBytes.push_back(static_cast<unsigned char>(value));
+}
+
+void ReplayEncoder::step(const GameInput& input){
+    unsigned char bits = encodeInput(input);
+    if (bits == 0){
+        mEmptySteps++;
+        return;
+    }
+
+    putVarint((mEmptySteps << 5) | bits);
+    mEmptySteps = 0;
+}
+
+void ReplayEncoder::finish(const GameState& game){
+    putVarint(mEmptySteps << 5);
+    putLE(mBytes, game.score(), 4);
+    putLE(mBytes, game.placedCount(), 4);
+    putLE(mBytes, game.field().hash(), 8);
+
+    mEmptySteps = 0;
+    mFinished = true;
+}
+
+ReplayDecoder::ReplayDecoder(){
+    open(NULL, 0);
+}
+
+bool ReplayDecoder::open(const unsigned char* data, size_t size){
+    mData = data;
+    mPos = data;
+    mEnd = data + size;
+    mHeader = {};
+    mFooter = {};
+    mHasFooter = false;
+    mCorrupt = false;
+    mEmptySteps = 0;
+    mPendingBits = 0;
+    mAtEnd = true;
+
+    if (data == NULL || size < REPLAY_HEADER_SIZE || std::memcmp(data, REPLAY_MAGIC, 4) != 0 || data[4] != REPLAY_VERSION){
+        mCorrupt = data != NULL;
+        return false;
+    }
+
+    // Without a step length gravity never runs, no game was played that way
+    if ((data[5] != PIECES_BAG7 && data[5] != PIECES_RANDOM) || getLE(data + 6, 2) == 0){
+        mCorrupt = true;
+        return false;
+    }
+
+    mHeader.pieceMode = static_cast<PieceMode>(data[5]);
+    mHeader.stepMs = static_cast<uint16_t>(getLE(data + 6, 2));
+    mHeader.seed = getLE(data + 8, 8);
+
+    mPos = data + REPLAY_HEADER_SIZE;
+    mAtEnd = false;
+    return true;
+}
+
+bool ReplayDecoder::getVarint(uint64_t& value){
+    value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7){
+        if (mPos == mEnd)
+            return false;
+
+        unsigned char byte = *mPos++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    mCorrupt = true;
+    return false;
+}
+
+bool ReplayDecoder::readRecord(){
+    /* Reads the next record. Running out of data means the recording was
+     * cut off, which leaves the replay without a footer */
+    uint64_t value;
+    if (!getVarint(value)){
+        mAtEnd = true;
+        return false;
+    }
+
+    unsigned char bits = value & 0x1F;
+    if ((bits & 0x07) > DIR_RIGHT){
+        mCorrupt = true;
+        mAtEnd = true;
+        return false;
+    }
+
+    mEmptySteps = value >> 5;
+    mPendingBits = bits;
+
+    if (bits == 0){
+        mAtEnd = true;
+        if (static_cast<size_t>(mEnd - mPos) < REPLAY_FOOTER_SIZE)
+            return true;
+
+        mFooter.score = static_cast<uint32_t>(getLE(mPos, 4));
+        mFooter.placedCount = static_cast<uint32_t>(getLE(mPos + 4, 4));
+        mFooter.fieldHash = getLE(mPos + 8, 8);
+        mPos += REPLAY_FOOTER_SIZE;
+        mHasFooter = true;
+    }
+
+    return true;
+}
+
+ReplayCursor ReplayDecoder::cursor() const{
+    ReplayCursor cursor;
+    cursor.offset = mPos - mData;
+    cursor.emptySteps = mEmptySteps;
+    cursor.pendingBits = mPendingBits;
+    cursor.atEnd = mAtEnd;
+    return cursor;
+}
+
+bool ReplayDecoder::seek(const ReplayCursor& cursor){
+    if (mData == NULL || cursor.offset < REPLAY_HEADER_SIZE || cursor.offset > static_cast<uint64_t>(mEnd - mData)
+            || (cursor.pendingBits & 0x07) > DIR_RIGHT)
+        return false;
+
+    mPos = mData + cursor.offset;
+    mEmptySteps = cursor.emptySteps;
+    mPendingBits = cursor.pendingBits & 0x1F;
+    mAtEnd = cursor.atEnd;
+    return true;
+}
+
+bool ReplayDecoder::next(GameInput& input){
+    for (;;){
+        if (mEmptySteps > 0){
+            mEmptySteps--;
+            input = GameInput();
+            return true;
+        }
+
+        if (mPendingBits != 0){
+            input = decodeInput(mPendingBits);
+            mPendingBits = 0;
+            return true;
+        }
+
+        if (mAtEnd || !readRecord())
+            return false;
+    }
+}
+
+ReplayResult verifyReplay(const unsigned char* data, size_t size, ReplayStepHook hook, void* userdata){
+    ReplayResult result;
+
+    ReplayDecoder decoder;
+    if (!decoder.open(data, size))
+        return result;
+
+    const ReplayHeader& header = decoder.header();
+    result.seed = header.seed;
+
+    GameState game(header.seed, header.pieceMode);
+    GameInput input;
+    while (decoder.next(input)){
+        game.step(input, header.stepMs);
+        result.steps++;
+
+        if (hook != NULL)
+            hook(game, decoder, result.steps, userdata);
+    }
+
+    result.simulated.score = game.score();
+    result.simulated.placedCount = game.placedCount();
+    result.simulated.fieldHash = game.field().hash();
+
+    if (decoder.isCorrupt())
+        result.status = REPLAY_CORRUPT;
+    else if (!decoder.hasFooter())
+        result.status = REPLAY_INCOMPLETE;
+    else {
+        result.recorded = decoder.footer();
+        bool same = result.simulated.score == result.recorded.score
+            && result.simulated.placedCount == result.recorded.placedCount
+            && result.simulated.fieldHash == result.recorded.fieldHash;
+        result.status = same ? REPLAY_OK : REPLAY_MISMATCH;
+    }
+
+    return result;
+}
+
+bool ReplayRecorder::begin(const char* path, const ReplayHeader& header){
+    if (!mWriter.open(path))
+        return false;
+
+    mEncoder.begin(header);
+    mEncoder.reserve(2 * CHUNK_SIZE);
+    handOff();
+    return true;
+}
+
+void ReplayRecorder::step(const GameInput& input){
+    if (!mWriter.isOpen())
+        return;
+
+    mEncoder.step(input);
+    if (mEncoder.bytes().size() >= CHUNK_SIZE)
+        handOff();
+}
+
+bool ReplayRecorder::finish(const GameState& game){
+    if (!mWriter.isOpen())
+        return true;
+
+    mEncoder.finish(game);
+    handOff();
+    std::string path = mWriter.path();
+    if (!mWriter.close()){
+        printf("Could not write replay %s!\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ReplayRecorder::handOff(){
+    mWriter.write(mEncoder.bytes().data(), mEncoder.bytes().size());
+    mEncoder.takeBytes();
+}
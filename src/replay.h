@@ -0,0 +1,172 @@
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "async_writer.h"
+#include "game.h"
+
+/* Replay file layout, all integers little endian:
+ *
+ *   header   "TRPL", version (u8), piece mode (u8), step ms (u16, never 0), seed (u64)
+ *   records  varint((steps << 5) | input bits), one per step with input
+ *   end      varint(steps << 5), score (u32), pieces (u32), field hash (u64)
+ *
+ * A game is the seed plus one GameInput per fixed logic step. Only steps
+ * with input are stored, steps counts the empty steps before it. The input
+ * bits are the direction in bits 0-2, rotate in bit 3 and drop in bit 4,
+ * so a record is never 0 and the end record stands out. It holds the empty
+ * steps after the last input and the final state to verify against */
+const unsigned char REPLAY_VERSION = 1;
+const size_t REPLAY_HEADER_SIZE = 16;
+const size_t REPLAY_FOOTER_SIZE = 16;
+
+struct ReplayHeader {
+    uint64_t seed;
+    PieceMode pieceMode;
+    uint16_t stepMs;
+};
+
+// Final state stored in the end record
+struct ReplayFooter {
+    uint32_t score;
+    uint32_t placedCount;
+    uint64_t fieldHash;
+};
+
+// Little endian helpers shared by the replay formats
+inline void putLE(std::vector<unsigned char>& out, uint64_t value, unsigned int nBytes){
+    for (unsigned int i = 0; i < nBytes; i++)
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+inline uint64_t getLE(const unsigned char* in, unsigned int nBytes){
+    uint64_t value = 0;
+    for (unsigned int i = 0; i < nBytes; i++)
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return value;
+}
+
+unsigned char encodeInput(const GameInput& input);
+GameInput decodeInput(unsigned char bits);
+
+// Builds a replay in memory, step by step
+class ReplayEncoder {
+    public:
+        ReplayEncoder();
+
+        void begin(const ReplayHeader& header);
+        void step(const GameInput& input);
+        void finish(const GameState& game);
+
+        bool isFinished() const { return mFinished; }
+
+        // Bytes encoded since the last takeBytes()
+        const std::vector<unsigned char>& bytes() const { return mBytes; }
+        void takeBytes() { mBytes.clear(); }
+        void reserve(size_t size) { mBytes.reserve(size); }
+
+    private:
+        std::vector<unsigned char> mBytes;
+        uint64_t mEmptySteps;
+        bool mFinished;
+
+        void putVarint(uint64_t value);
+};
+
+// Position of a ReplayDecoder in its data, for resuming from the middle of a replay
+struct ReplayCursor {
+    uint64_t offset;
+    uint64_t emptySteps;
+    unsigned char pendingBits;
+    bool atEnd;
+};
+
+/* Reads a replay back as one GameInput per step. The data has to stay
+ * alive while the decoder is used, nothing is copied */
+class ReplayDecoder {
+    public:
+        ReplayDecoder();
+
+        // Reads the header, false if the data isn't a replay
+        bool open(const unsigned char* data, size_t size);
+
+        // Input of the next step, false once the recorded steps are used up or the data is cut off
+        bool next(GameInput& input);
+
+        const ReplayHeader& header() const { return mHeader; }
+
+        // Continues from a cursor taken on the same data, false if it doesn't fit the data
+        ReplayCursor cursor() const;
+        bool seek(const ReplayCursor& cursor);
+
+        // Valid after next() returned false on a complete replay
+        bool hasFooter() const { return mHasFooter; }
+        const ReplayFooter& footer() const { return mFooter; }
+
+        // Set when the data isn't a replay or a record is malformed
+        bool isCorrupt() const { return mCorrupt; }
+
+    private:
+        const unsigned char* mData;
+        const unsigned char* mPos;
+        const unsigned char* mEnd;
+
+        ReplayHeader mHeader;
+        ReplayFooter mFooter;
+        bool mHasFooter;
+        bool mCorrupt;
+
+        uint64_t mEmptySteps;  // Empty steps left before mPendingBits
+        unsigned char mPendingBits;
+        bool mAtEnd;
+
+        bool readRecord();
+        bool getVarint(uint64_t& value);
+};
+
+enum ReplayStatus {
+    REPLAY_OK,          // Re-simulation matches the recorded final state
+    REPLAY_MISMATCH,    // Simulated score, piece count or field differ from the recording
+    REPLAY_INCOMPLETE,  // Recording stops before the end record, nothing to verify against
+    REPLAY_CORRUPT      // Not a replay, or a malformed record
+};
+
+struct ReplayResult {
+    ReplayStatus status = REPLAY_CORRUPT;
+    uint64_t seed = 0;
+    uint64_t steps = 0;
+    ReplayFooter simulated = {};
+    ReplayFooter recorded = {};
+};
+
+// Called after every simulated step, step counts from 1
+typedef void (*ReplayStepHook)(const GameState& game, const ReplayDecoder& decoder, uint64_t step, void* userdata);
+
+// Re-simulates the replay headlessly and compares the final state with the end record
+ReplayResult verifyReplay(const unsigned char* data, size_t size, ReplayStepHook hook = NULL, void* userdata = NULL);
+
+/* Records the game being played to a file. Encoded bytes are handed to an
+ * AsyncFileWriter in small chunks, so recording never waits for the disk */
+class ReplayRecorder {
+    public:
+        bool begin(const char* path, const ReplayHeader& header);
+        void step(const GameInput& input);
+
+        // Writes the end record and closes the file, false if the file could not be written completely
+        bool finish(const GameState& game);
+
+        bool isRecording() const { return mWriter.isOpen(); }
+
+    private:
+        static const size_t CHUNK_SIZE = 256;
+
+        ReplayEncoder mEncoder;
+        AsyncFileWriter mWriter;
+
+        void handOff();
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+#include "replay.h"
+#include "thread_pool.h"
+
+/* Re-simulates recorded games headlessly as fast as the cores allow and
+ * checks every final score, piece count and field hash against the end
+ * record. Directories are searched for .trp files, one task per replay.
+ * Exits with 1 if any replay fails to verify.
+ *
+ * Usage: tetris-replay [-j threads] <replay file or directory>... */
+
+// Per-worker totals, padded so workers never write to the same cache line
+struct alignas(64) ReplayStats {
+    unsigned long long counts[4] = {};  // Indexed by ReplayStatus
+    unsigned long long steps = 0;
+    unsigned long long pieces = 0;
+    unsigned long long bytes = 0;
+    std::vector<std::string> failures;
+};
+
+bool readFile(const std::string& path, std::vector<unsigned char>& data){
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+std::string describe(const std::string& path, const ReplayResult& result){
+    const char* statusNames[4] = {"ok", "MISMATCH", "incomplete", "corrupt"};
+
+    std::string text = path + ": " + statusNames[result.status];
+    if (result.status == REPLAY_MISMATCH){
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), " (seed %llu, score %u recorded %u, pieces %u recorded %u, field %016llx recorded %016llx)",
+                static_cast<unsigned long long>(result.seed),
+                result.simulated.score, result.recorded.score,
+                result.simulated.placedCount, result.recorded.placedCount,
+                static_cast<unsigned long long>(result.simulated.fieldHash),
+                static_cast<unsigned long long>(result.recorded.fieldHash));
+        text += buffer;
+    }
+
+    return text;
+}
+
+int main(int argc, char* args[]){
+    unsigned int nThreads = 0;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++){
+        std::string arg = args[i];
+        if (arg == "-j" && i + 1 < argc)
+            nThreads = std::atoi(args[++i]);
+        else
+            paths.push_back(arg);
+    }
+
+    if (paths.empty()){
+        std::cout << "Usage: tetris-replay [-j threads] <replay file or directory>...\n";
+        return 1;
+    }
+
+    // Collect the replays first so the pool gets one flat list of tasks
+    std::vector<std::string> files;
+    for (const std::string& path : paths){
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)){
+            for (const auto& entry : std::filesystem::directory_iterator(path, error))
+                if (entry.is_regular_file() && entry.path().extension() == ".trp")
+                    files.push_back(entry.path().string());
+        }
+        else
+            files.push_back(path);
+    }
+
+    WorkStealingPool pool(nThreads);
+    std::vector<ReplayStats> workerStats(pool.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (const std::string& file : files){
+        pool.submit([&file, &pool, &workerStats]{
+            ReplayStats& stats = workerStats[pool.currentWorker()];
+
+            // Each worker reuses its own buffer
+            thread_local std::vector<unsigned char> data;
+
+            ReplayResult result;
+            if (readFile(file, data))
+                result = verifyReplay(data.data(), data.size());
+
+            stats.counts[result.status]++;
+            stats.steps += result.steps;
+            stats.pieces += result.simulated.placedCount;
+            stats.bytes += data.size();
+            if (result.status != REPLAY_OK)
+                stats.failures.push_back(describe(file, result));
+        });
+    }
+    pool.wait();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ReplayStats total;
+    for (const ReplayStats& s : workerStats){
+        for (int i = 0; i < 4; i++)
+            total.counts[i] += s.counts[i];
+        total.steps += s.steps;
+        total.pieces += s.pieces;
+        total.bytes += s.bytes;
+        for (const std::string& failure : s.failures)
+            std::cout << failure << "\n";
+    }
+
+    std::cout << "Threads:        " << pool.size() << "\n";
+    std::cout << "Replays:        " << files.size() << " in " << seconds << " s\n";
+    std::cout << "Verified:       " << total.counts[REPLAY_OK] << "\n";
+    std::cout << "Mismatched:     " << total.counts[REPLAY_MISMATCH] << "\n";
+    std::cout << "Incomplete:     " << total.counts[REPLAY_INCOMPLETE] << "\n";
+    std::cout << "Corrupt:        " << total.counts[REPLAY_CORRUPT] << "\n";
+    std::cout << "Bytes/piece:    " << (total.pieces ? static_cast<double>(total.bytes) / total.pieces : 0) << "\n";
+    std::cout << "replays/s:      " << files.size() / seconds << "\n";
+    std::cout << "steps/s:        " << total.steps / seconds << "\n";
+
+    return total.counts[REPLAY_OK] == files.size() ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#ifndef TETRIS_SPSC_RING_H
+#define TETRIS_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+/* Fixed size queue for exactly one producer thread and one consumer
+ * thread. Neither side ever blocks or allocates: push() fails when the
+ * ring is full and pop() fails when it is empty. Capacity must be a
+ * power of two */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        SpscRing() : mHead(0), mTail(0) {}
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        // Producer side
+        bool push(const T& item){
+            size_t tail = mTail.load(std::memory_order_relaxed);
+            if (tail - mHead.load(std::memory_order_acquire) == Capacity)
+                return false;
+
+            mItems[tail & (Capacity - 1)] = item;
+            mTail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. front() looks at the oldest item without removing it
+        bool front(T& item) const {
+            size_t head = mHead.load(std::memory_order_relaxed);
+            if (head == mTail.load(std::memory_order_acquire))
+                return false;
+
+            item = mItems[head & (Capacity - 1)];
+            return true;
+        }
+
+        bool pop(T& item){
+            if (!front(item))
+                return false;
+
+            mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const {
+            return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+        }
+
+    private:
+        // Each index on its own cache line so the two threads don't keep stealing it from each other
+        alignas(64) std::atomic<size_t> mHead;
+        alignas(64) std::atomic<size_t> mTail;
+        alignas(64) T mItems[Capacity];
+};
+
+#endif
@@ -0,0 +1,235 @@
+#include "state_feed.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static const char STATE_FEED_MAGIC[4] = {'T', 'S', 'F', 'D'};
+static const unsigned int READ_ATTEMPTS = 4;
+
+StateFeed::StateFeed(){
+    mLayout = NULL;
+    mName[0] = '\0';
+    mTick = 0;
+    mPopped = 0;
+    mPoppedTime = 0;
+    mApplied = 0;
+}
+
+StateFeed::~StateFeed(){
+    close();
+}
+
+bool StateFeed::open(const char* name){
+    close();
+
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0){
+        printf("Could not create shared memory %s!\n", name);
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(StateFeedLayout)) != 0){
+        printf("Could not size shared memory %s!\n", name);
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void* data = mmap(NULL, sizeof(StateFeedLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED){
+        printf("Could not map shared memory %s!\n", name);
+        shm_unlink(name);
+        return false;
+    }
+
+    // The new segment is all zeros, which is a valid empty feed apart from the header
+    mLayout = new (data) StateFeedLayout();
+    mLayout->version = STATE_FEED_VERSION;
+    mLayout->slots = STATE_FEED_SLOTS;
+    mLayout->stateSize = sizeof(FeedState);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(mLayout->magic, STATE_FEED_MAGIC, sizeof(STATE_FEED_MAGIC));
+
+    std::snprintf(mName, sizeof(mName), "%s", name);
+    mTick = 0;
+    mPopped = 0;
+    mPoppedTime = 0;
+    mApplied = 0;
+    return true;
+}
+
+void StateFeed::close(){
+    if (mLayout == NULL)
+        return;
+
+    munmap(mLayout, sizeof(StateFeedLayout));
+    shm_unlink(mName);
+    mLayout = NULL;
+}
+
+void StateFeed::publish(const GameState& game, uint64_t stepEnd){
+    if (mLayout == NULL)
+        return;
+
+    // Steps only decode the events stamped up to their end
+    if (stepEnd >= mPoppedTime)
+        mApplied = mPopped;
+
+    mTick++;
+    StateFeedLayout::Slot& slot = mLayout->slot[mTick % STATE_FEED_SLOTS];
+
+    // Odd while writing, so readers racing this copy throw theirs away
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    FeedState& state = slot.state;
+    const Tetromino& active = game.activeTetromino();
+    state.tick = mTick;
+    state.seed = game.seed();
+    state.inputsApplied = mApplied;
+    state.score = game.score();
+    state.placedCount = game.placedCount();
+    state.activeX = active.x;
+    state.activeY = active.y;
+    state.activeShape = active.shape;
+    state.activeRotation = active.rotation;
+    state.activeVisible = active.visible;
+    state.nextShape = game.nextTetromino().shape;
+    state.gameOver = game.isGameOver();
+    for (unsigned char r = 0; r < FIELD_ROWS; r++)
+        for (unsigned char c = 0; c < FIELD_COLS; c++)
+            state.colors[r][c] = game.field().get(r, c);
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    mLayout->latest.store(mTick, std::memory_order_release);
+}
+
+bool StateFeed::popInput(uint64_t time, InputAction& action, bool& pressed){
+    if (mLayout == NULL)
+        return false;
+
+    /* The other process is not trusted. The head is kept here rather than
+     * read back from the shared memory, and a tail that claims more than a
+     * full ring of inputs throws away everything it claims to hold */
+    uint64_t tail = mLayout->inputTail.load(std::memory_order_acquire);
+    if (tail - mPopped > STATE_FEED_INPUT_SIZE){
+        mPopped = tail;
+        mPoppedTime = time;
+        mLayout->inputHead.store(mPopped, std::memory_order_release);
+        return false;
+    }
+
+    // Entries with invalid actions are skipped
+    bool found = false;
+    while (!found && mPopped != tail){
+        const FeedInput& input = mLayout->inputs[mPopped % STATE_FEED_INPUT_SIZE];
+        unsigned char value = input.action;
+        pressed = input.pressed != 0;
+        mPopped++;
+
+        if (value < NUM_INPUT_ACTIONS){
+            action = static_cast<InputAction>(value);
+            found = true;
+        }
+    }
+
+    if (mLayout->inputHead.load(std::memory_order_relaxed) != mPopped){
+        mPoppedTime = time;
+        mLayout->inputHead.store(mPopped, std::memory_order_release);
+    }
+    return found;
+}
+
+StateFeedReader::StateFeedReader(){
+    mLayout = NULL;
+}
+
+StateFeedReader::~StateFeedReader(){
+    close();
+}
+
+bool StateFeedReader::open(const char* name){
+    close();
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0){
+        printf("Could not open shared memory %s!\n", name);
+        return false;
+    }
+
+    void* data = mmap(NULL, sizeof(StateFeedLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED){
+        printf("Could not map shared memory %s!\n", name);
+        return false;
+    }
+
+    mLayout = static_cast<StateFeedLayout*>(data);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (std::memcmp(mLayout->magic, STATE_FEED_MAGIC, sizeof(STATE_FEED_MAGIC)) != 0
+            || mLayout->version != STATE_FEED_VERSION || mLayout->slots != STATE_FEED_SLOTS
+            || mLayout->stateSize != sizeof(FeedState)){
+        printf("%s is not a compatible state feed!\n", name);
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void StateFeedReader::close(){
+    if (mLayout == NULL)
+        return;
+
+    munmap(mLayout, sizeof(StateFeedLayout));
+    mLayout = NULL;
+}
+
+uint64_t StateFeedReader::latestTick() const{
+    return mLayout != NULL ? mLayout->latest.load(std::memory_order_acquire) : 0;
+}
+
+bool StateFeedReader::readLatest(FeedState& state) const{
+    for (unsigned int attempt = 0; attempt < READ_ATTEMPTS; attempt++){
+        uint64_t tick = latestTick();
+        if (tick == 0)
+            return false;
+
+        const StateFeedLayout::Slot& slot = mLayout->slot[tick % STATE_FEED_SLOTS];
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        std::memcpy(&state, &slot.state, sizeof(state));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before && state.tick == tick)
+            return true;
+    }
+
+    return false;
+}
+
+bool StateFeedReader::pushInput(InputAction action, bool pressed){
+    if (mLayout == NULL)
+        return false;
+
+    uint64_t tail = mLayout->inputTail.load(std::memory_order_relaxed);
+    if (tail - mLayout->inputHead.load(std::memory_order_acquire) == STATE_FEED_INPUT_SIZE)
+        return false;
+
+    FeedInput& input = mLayout->inputs[tail % STATE_FEED_INPUT_SIZE];
+    input.action = action;
+    input.pressed = pressed;
+    mLayout->inputTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+uint64_t StateFeedReader::inputsSent() const{
+    return mLayout != NULL ? mLayout->inputTail.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,134 @@
+#ifndef TETRIS_STATE_FEED_H
+#define TETRIS_STATE_FEED_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "game.h"
+#include "input.h"
+
+/* Game state published into POSIX shared memory after every logic step,
+ * for bots and spectators running as separate processes on the same host.
+ * Readers map the segment and copy states straight out of it, without
+ * any system call or serialization, and may send inputs back through a
+ * ring the game treats like keyboard input.
+ *
+ * States go into a ring of STATE_FEED_SLOTS slots, tick t into slot
+ * t % STATE_FEED_SLOTS. Every slot is a seqlock: its sequence is odd while
+ * the game writes it, and a reader keeps a copy only if the sequence was
+ * even and unchanged before and after copying. Any number of processes
+ * can read, only one may send inputs at a time */
+const uint32_t STATE_FEED_VERSION = 1;
+const unsigned int STATE_FEED_SLOTS = 8;
+const size_t STATE_FEED_INPUT_SIZE = 256;
+
+// One logic step, all fields plain bytes and integers so any language can read them
+struct FeedState {
+    uint64_t tick;  // Logic steps published before this one plus 1
+    uint64_t seed;  // Changes when a new game starts
+    uint64_t inputsApplied;  // Inputs sent through the feed that this state already reflects
+    uint32_t score;
+    uint32_t placedCount;
+    int8_t activeX;
+    int8_t activeY;
+    uint8_t activeShape;
+    uint8_t activeRotation;
+    uint8_t activeVisible;
+    uint8_t nextShape;
+    uint8_t gameOver;
+    uint8_t reserved;
+    uint8_t colors[FIELD_ROWS][FIELD_COLS];  // 0 for empty cells
+};
+
+struct FeedInput {
+    uint8_t action;  // InputAction
+    uint8_t pressed;
+};
+
+// The whole shared memory segment
+struct StateFeedLayout {
+    char magic[4];  // "TSFD"
+    uint32_t version;
+    uint32_t slots;
+    uint32_t stateSize;
+
+    alignas(64) std::atomic<uint64_t> latest;  // Tick of the newest complete state, 0 before the first
+
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> sequence;
+        FeedState state;
+    } slot[STATE_FEED_SLOTS];
+
+    // Inputs from the one writing process to the game
+    alignas(64) std::atomic<uint64_t> inputHead;  // Advanced by the game
+    alignas(64) std::atomic<uint64_t> inputTail;  // Advanced by the writer
+    FeedInput inputs[STATE_FEED_INPUT_SIZE];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+        "Shared memory needs address free atomics");
+
+// Game side. Creates the segment and removes it again on close()
+class StateFeed {
+    public:
+        StateFeed();
+        ~StateFeed();
+
+        StateFeed(const StateFeed&) = delete;
+        StateFeed& operator=(const StateFeed&) = delete;
+
+        // name is a POSIX shared memory name such as "/tetris"
+        bool open(const char* name);
+        void close();
+
+        bool isOpen() const { return mLayout != NULL; }
+
+        // Publishes the state after the logic step ending at stepEnd
+        void publish(const GameState& game, uint64_t stepEnd);
+
+        /* Next input sent by a reader, false when there is none. time is
+         * the timestamp the game queues it with, so publish() can tell
+         * which steps have seen it. Looks at no more than one ring of
+         * inputs per call, whatever the reader wrote */
+        bool popInput(uint64_t time, InputAction& action, bool& pressed);
+
+    private:
+        StateFeedLayout* mLayout;
+        char mName[64];
+        uint64_t mTick;
+
+        uint64_t mPopped;       // Input ring head, only ever trusted from here
+        uint64_t mPoppedTime;   // Timestamp of the latest popped input
+        uint64_t mApplied;
+};
+
+// Reader side, for any process that maps an existing feed
+class StateFeedReader {
+    public:
+        StateFeedReader();
+        ~StateFeedReader();
+
+        StateFeedReader(const StateFeedReader&) = delete;
+        StateFeedReader& operator=(const StateFeedReader&) = delete;
+
+        bool open(const char* name);
+        void close();
+
+        uint64_t latestTick() const;
+
+        /* Copies the newest state. Returns false if nothing was published
+         * yet, or if the game kept overwriting the slot while it was read */
+        bool readLatest(FeedState& state) const;
+
+        // Queues an input for the game, false while the ring is full
+        bool pushInput(InputAction action, bool pressed);
+
+        // Inputs pushed so far, a state reflects all of them once its inputsApplied reaches this
+        uint64_t inputsSent() const;
+
+    private:
+        StateFeedLayout* mLayout;
+};
+
+#endif
@@ -1,883 +1,1007 @@
-#include <iostream>
-#include <vector>
-#include <string>
-#include <stack>
-#include <algorithm>
-#include <map>
-#include <ctime>
-#include <random>
-#include <chrono>
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_ttf.h>
-
-// 22x10 Array of unsigned chars initialized to 0
-std::vector<std::vector<unsigned char>> fieldMat(22, std::vector<unsigned char>(10, 0));
-
-// Tetrominos
-struct Tetromino {
-    char x;
-    char y;
-	bool visible = true;
-
-    std::vector<std::vector<unsigned char>> shape;
-};
-
-std::map<unsigned char, std::vector<std::vector<unsigned char>>> TETROMINO_SHAPES = {
-    {'T', {{0, 1, 0},
-           {1, 1, 1},
-           {0, 0, 0}}
-    },
-    {'B', {{2, 2},
-           {2, 2}}
-    },
-    {'S', {{0, 3, 3},
-           {3, 3, 0},
-           {0, 0, 0}}
-    },
-    {'Z', {{4, 4, 0},
-           {0, 4, 4},
-           {0, 0, 0}}
-    },
-    {'L', {{5, 5, 5},
-           {0, 0, 5},
-           {0, 0, 0}}
-    },
-    {'J', {{0, 0, 6},
-           {6, 6, 6},
-           {0, 0, 0}}
-    },
-    {'I', {{0, 0, 0, 0},
-           {7, 7, 7, 7},
-           {0, 0, 0, 0},
-           {0, 0, 0, 0}}
-    }
-};
-
-const std::vector<unsigned char> SHAPES_AVAILABLE = {'T', 'B', 'S', 'Z', 'L', 'J', 'I'};
-
-enum Direction {
-    DIR_NONE, DIR_UP, DIR_DOWN, DIR_LEFT, DIR_RIGHT
-};
-
-const int SCREEN_WIDTH = 800;
-const int SCREEN_HEIGHT = 600;
-const unsigned char BLOCK_SIZE = 28;  // px
-const int OFFSET_X = 40;
-const int OFFSET_Y = -40;
-const int OFFSET_X_NEXT = SCREEN_WIDTH / 2 - 50;
-const int OFFSET_Y_NEXT = 50;
-const int INPUT_REPEAT_DELAY = 100;
-const unsigned SEED = std::chrono::system_clock::now().time_since_epoch().count();
-
-SDL_Window* gWindow = NULL;
-SDL_Renderer* gRenderer = NULL;
-SDL_Joystick* gGameController = NULL;
-TTF_Font *gFont = NULL;
-
-SDL_Texture** gPreRendered = NULL;
-SDL_Texture** gPreRenderedGhost = NULL;
-
-class LTexture {
-    public:
-        LTexture();
-        ~LTexture();
-
-        void free();
-        void render(int x, int y);
-
-        bool loadFromRenderedText(std::string textureText, SDL_Color textColor);
-
-    private:
-        int mWidth;
-        int mHeight;
-        SDL_Texture* mTexture;
-};
-
-LTexture::LTexture(){
-   mTexture = NULL;
-   mWidth = 0;
-   mHeight = 0;
-}
-
-LTexture::~LTexture(){
-    free();
-}
-
-void LTexture::free(){
-    if(mTexture != NULL) {
-        SDL_DestroyTexture(mTexture);
-        mTexture = NULL;
-        mWidth = 0;
-        mHeight = 0;
-    }
-}
-
-void LTexture::render(int x, int y){
-    // Set rendering space and render to screen
-    SDL_SetRenderDrawColor(gRenderer, 0x00, 0xFF, 0x00, 0xFF);
-    SDL_Rect renderQuad = { x, y, mWidth, mHeight };
-
-    SDL_RenderCopy(gRenderer, mTexture, NULL, &renderQuad);
-}
-
-bool LTexture::loadFromRenderedText(std::string textureText, SDL_Color textColor){
-    // Clear previous texture
-    free();
-
-    //Render text surface
-    SDL_Surface* textSurface = TTF_RenderText_Blended(gFont, textureText.c_str(), textColor);
-    if (textSurface == NULL){
-        printf("Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError());
-        return false;
-    }
-
-    // Create texture from surface pixels
-    mTexture = SDL_CreateTextureFromSurface(gRenderer, textSurface);
-    if(mTexture == NULL){
-        printf("Unable to create texture from rendered text! SDL Error %s\n", SDL_GetError());
-        return false;
-    }
-    else {
-        mWidth = textSurface->w;
-        mHeight = textSurface->h;
-    }
-    
-    // The surface is no longer needed 
-    SDL_FreeSurface(textSurface);
-
-    // Return success
-    return true;
-
-}
-
-LTexture gTextTexture;
-
-Uint32 getColorFromValue(const SDL_PixelFormat* format, unsigned char blockValue){
-    switch(blockValue){
-        case 1:
-            return SDL_MapRGB(format, 0xFF, 0x00, 0x00);
-        case 2:
-            return SDL_MapRGB(format, 0x00, 0xFF, 0x00);
-        case 3:
-            return SDL_MapRGB(format, 0x00, 0x00, 0xFF);
-        case 4:
-            return SDL_MapRGB(format, 0xFF, 0xFF, 0x00);
-        case 5:
-            return SDL_MapRGB(format, 0xFF, 0x00, 0xFF);
-        case 6:
-            return SDL_MapRGB(format, 0x00, 0xFF, 0xFF);
-        case 7:
-            return SDL_MapRGB(format, 0xFF, 0x80, 0x00);
-        default:
-            return SDL_MapRGB(format, 0xFF, 0xFF, 0xFF);
-            break;
-    }
-}
-
-
-class InputManager {
-	private:
-		SDL_Event e;
-		
-		Direction stateDirection = DIR_NONE;
-		bool stateDrop = false;
-		bool stateRotate = false;
-		bool stateReturn = false;
-		bool stateQuit = false;
-
-		bool checkInputTimer();
-		Uint32 inputTimer = 0;
-
-
-	public:
-		Direction getStateDirection();
-		bool getStateRotate();
-		bool getStateDrop();
-		bool getStateQuit();
-
-		void processInput();
-
-		InputManager();
-		~InputManager();
-};
-
-InputManager::InputManager(){
-}
-
-InputManager::~InputManager(){
-}
-
-
-Direction InputManager::getStateDirection(){
-	static Uint32 dirTimer = 0;
-	static Direction prevDir = DIR_NONE;
-	
-	if (stateDirection == prevDir && prevDir != DIR_NONE)
-		if (SDL_GetTicks() - dirTimer > INPUT_REPEAT_DELAY){
-			dirTimer = SDL_GetTicks();
-			return stateDirection;
-		}
-		else{
-			return DIR_NONE;
-		}
-	else{
-		prevDir = stateDirection;
-		dirTimer = SDL_GetTicks();
-		return stateDirection;
-	}
-}
-
-bool InputManager::getStateDrop(){
-	static Uint32 dropTimer = 0;
-	static bool prevState = false;
-
-	if (prevState != stateDrop || SDL_GetTicks() - dropTimer > 2*INPUT_REPEAT_DELAY){
-		dropTimer = SDL_GetTicks();
-		prevState = stateDrop;
-		return stateDrop;
-	}
-	else
-		return false;
-}
-
-bool InputManager::getStateRotate(){
-	static Uint32 rotateTimer = 0;
-	static bool prevState = false;
-
-	if (prevState != stateRotate || SDL_GetTicks() - rotateTimer > 2*INPUT_REPEAT_DELAY){
-		rotateTimer = SDL_GetTicks();
-		prevState = stateRotate;
-		return stateRotate;
-	}
-	else
-		return false;
-}
-
-bool InputManager::getStateQuit(){
-	return stateQuit;
-}
-
-void InputManager::processInput(){
-	while (SDL_PollEvent(&e) != 0){
-		// Window close event
-		if (e.type == SDL_QUIT)
-			stateQuit = true;
-
-		// Keyboard
-		else if (e.type == SDL_KEYDOWN){
-			switch(e.key.keysym.sym){
-				case SDLK_LEFT:
-					stateDirection =  DIR_LEFT;
-					break;
-				case SDLK_RIGHT:
-					stateDirection =  DIR_RIGHT;
-					break;
-				case SDLK_UP:
-					stateDirection = DIR_UP;
-					break;
-				case SDLK_DOWN:
-					stateDirection = DIR_DOWN;
-					break;
-				case SDLK_LSHIFT:
-				case SDLK_RETURN:
-					stateRotate = true;
-					break;
-				case SDLK_SPACE:
-					stateDrop = true;
-					break;
-			}
-		}
-
-		else if (e.type == SDL_KEYUP){
-			switch(e.key.keysym.sym){
-				case SDLK_LEFT:
-				case SDLK_RIGHT:
-				case SDLK_UP:
-				case SDLK_DOWN:
-					stateDirection = DIR_NONE;
-					break;
-				case SDLK_LSHIFT:
-				case SDLK_RETURN:
-					stateRotate = false;
-					break;
-				case SDLK_SPACE:
-					stateDrop = false;
-					break;
-			}
-		}
-
-		
-		// Gamepad Buttons
-		else if (e.type == SDL_JOYBUTTONDOWN){
-			if(e.jbutton.button == 0)
-				stateDrop = true;
-			else if(e.jbutton.button == 1)
-				stateRotate = true;
-		}
-		else if (e.type == SDL_JOYBUTTONUP){
-			if(e.jbutton.button == 0)
-				stateDrop = false;
-			else if(e.jbutton.button == 1)
-				stateRotate = false;
-		}
-
-		// Gamepad D-pad
-		else if (e.type == SDL_JOYHATMOTION){
-			if(e.jhat.value & SDL_HAT_RIGHT)
-				stateDirection = DIR_RIGHT;
-			else if(e.jhat.value & SDL_HAT_LEFT)
-				stateDirection = DIR_LEFT;
-			else if(e.jhat.value & SDL_HAT_UP)
-				stateDirection = DIR_UP;
-			else if(e.jhat.value & SDL_HAT_DOWN)
-				stateDirection = DIR_DOWN;
-			else {
-				stateDirection = DIR_NONE;
-			}
-		}
-
-	}
-}
-
-bool loadFonts(){
-    gFont = TTF_OpenFont("consola.ttf", 24);
-    if(gFont == NULL){
-        printf("Could not load font! SDL_ttf Error: %s\n", TTF_GetError());
-        return false;
-    }
-    
-    return true;
-}
-
-bool init(){
-    bool success = true;
-    if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) < 0){
-        printf("SDL Could not initialize! SDL Error: %s\n", SDL_GetError());
-        success = false;
-    }
-    else{
-        gWindow = SDL_CreateWindow("Tetris Clone", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL);
-        if(gWindow == NULL){
-            printf("Could not create window! SDL Error: %s\n", SDL_GetError());
-            success = false;
-        }
-        else{
-            gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED);
-            if (gRenderer == NULL){
-                printf("Could not create renderer: %s\n", SDL_GetError());
-                success = false;
-            }
-            else{
-                SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xFF);
-            }
-        }
-    }
-
-    if(TTF_Init() == -1){
-        printf("SDL_ttf could not be initialized! SDL_ttf Error: %s\n", TTF_GetError());
-        return false;
-    }
-
-    if(!loadFonts()){
-        printf("Could not load font! \n");
-        return false;
-    }
-
-    gGameController = SDL_JoystickOpen(0);
-    if(gGameController == NULL){
-        printf("No game controllers detected: %s\n", SDL_GetError());
-    }
-
-    // Pre render textures of blocks
-    gPreRendered = new SDL_Texture*[8];
-    for (unsigned char i = 0; i < 8; i++){
-        SDL_Surface* surf = SDL_CreateRGBSurface(0, BLOCK_SIZE, BLOCK_SIZE, 32, 0, 0, 0, 0);
-        SDL_Rect blockOuter = {0, 0, BLOCK_SIZE, BLOCK_SIZE};
-        SDL_Rect blockInner = {2, 2, BLOCK_SIZE - 4, BLOCK_SIZE - 4};
-
-        SDL_FillRect(surf, &blockOuter, getColorFromValue(surf->format, i));
-        SDL_FillRect(surf, &blockInner, 0.4*getColorFromValue(surf->format, i));
-        gPreRendered[i] = SDL_CreateTextureFromSurface(gRenderer,  surf);
-
-        SDL_FreeSurface(surf);
-    }
-	
-	// Pre render ghost pieces
-    gPreRenderedGhost = new SDL_Texture*[8];
-    for (unsigned char i = 0; i < 8; i++){
-        SDL_Surface* surf = SDL_CreateRGBSurface(0, BLOCK_SIZE, BLOCK_SIZE, 32, 0, 0, 0x00, 0x00);
-        SDL_Rect blockOuter = {0, 0, BLOCK_SIZE, BLOCK_SIZE};
-        SDL_Rect blockInner = {2, 2, BLOCK_SIZE - 4, BLOCK_SIZE - 4};
-
-        SDL_FillRect(surf, &blockOuter, getColorFromValue(surf->format, i));
-		SDL_FillRect(surf, &blockInner, SDL_MapRGB(surf->format, 0x00, 0x00, 0x00));
-        gPreRenderedGhost[i] = SDL_CreateTextureFromSurface(gRenderer,  surf);
-		SDL_SetTextureBlendMode(gPreRenderedGhost[i], SDL_BLENDMODE_BLEND);
-		SDL_SetTextureAlphaMod(gPreRenderedGhost[i], 0x50);
-
-        SDL_FreeSurface(surf);
-    }
-
-    return success;
-}
-
-void close(){
-    // Free textures and fonts
-    gTextTexture.free();
-    TTF_CloseFont(gFont);
-    gFont = NULL;
-	for (unsigned char i = 0; i < 8; i++) {
-		SDL_DestroyTexture(gPreRendered[i]);
-		SDL_DestroyTexture(gPreRenderedGhost[i]);
-	}
-
-    delete[] gPreRendered;
-    delete[] gPreRenderedGhost;
-    
-    // Destroy renderer
-    SDL_DestroyRenderer(gRenderer);
-    gRenderer = NULL;
-    SDL_DestroyWindow(gWindow);
-    gWindow = NULL;
-    
-    // Close joysticks
-    if(gGameController != NULL){
-        SDL_JoystickClose(gGameController);
-        gGameController = NULL;
-    }
-    
-    // Quit subsystems
-    TTF_Quit();
-    SDL_Quit();
-}
-
-bool collidesWith(const Tetromino& tetromino, const std::vector<std::vector<unsigned char>>& fieldMat){
-    // Checks if a tetromino collides with the field or the boundaries of the field
-    
-    // Loop trough each cell in the tetromino grid
-    unsigned int tSize = tetromino.shape.size(); 
-
-    for(unsigned char rt = 0; rt < tSize; rt++)
-        for(unsigned char ct = 0; ct < tSize; ct++){
-            if(tetromino.shape[rt][ct] == 0)  // Empty space can't collide
-                continue;
-            
-            unsigned char rf = tetromino.y + rt;  // Calculate row in field for this block
-            unsigned char cf = tetromino.x + ct;  // Calculate column in field for this block
-
-            // Collides with field boundaries?
-            if (rf >= fieldMat.size())
-                return true;
-            if (cf >= fieldMat[0].size())
-                return true;
-            
-            // Collides with block on the field?
-            if(fieldMat[rf][cf] != 0)
-                return true;
-        }
-    
-    // Checked all tetromino blocks and found no collision 
-    return false;
-}
-
-bool move(Tetromino& tetromino, const std::vector<std::vector<unsigned char>>& fieldMat, const char direction){
-    /* Attempts to move the tetromino 1 step in provided direction. 
-     * Returns true if move is successful, or false if the move is
-     * impossible due to a collision. */
-     
-    // Move the piece
-    switch(direction){
-        case DIR_UP:
-            tetromino.y--;
-            break;
-        case DIR_DOWN:
-            tetromino.y++;
-            break;
-        case DIR_LEFT:
-            tetromino.x--;
-            break;
-        case DIR_RIGHT:
-            tetromino.x++;
-            break;
-    }
-
-    // Cancel the move on collision
-    if(collidesWith(tetromino, fieldMat)){
-        switch(direction){
-            case DIR_UP:
-                tetromino.y++;
-                break;
-            case DIR_DOWN:
-                tetromino.y--;
-                break;
-            case DIR_LEFT:
-                tetromino.x++;
-                break;
-            case DIR_RIGHT:
-                tetromino.x--;
-                break;
-        }
-
-        return false;
-    }
-    else
-        return true;
-}
-
-void renderField(const std::vector<std::vector<unsigned char>>& fieldMat,
-        const Tetromino& tetromino, const Tetromino& nextTetromino){
-
-    // Renders blocks in FieldMat and the active tetromino
-    SDL_Rect currentBlock = {0, 0, BLOCK_SIZE-1, BLOCK_SIZE-1};
-    
-	// Render field
-    const std::vector<unsigned char>* field = &fieldMat[0];
-    for (unsigned int r = 2; r < fieldMat.size(); r++){ // Don't render top 2 lines
-
-        const unsigned char *vRow = &field[r][0];
-        for (unsigned int c = 0; c < fieldMat[0].size(); c++){
-
-            currentBlock.x = OFFSET_X + c * BLOCK_SIZE;
-            currentBlock.y = OFFSET_Y + r * BLOCK_SIZE;
-            
-            if(vRow[c] > 0)
-                SDL_RenderCopy(gRenderer, gPreRendered[vRow[c]], NULL, &currentBlock);
-        }
-    }
-    
-    // Render active tetromino
-	if (tetromino.visible) {
-		unsigned int tSize = tetromino.shape.size();
-		const std::vector <unsigned char>* shape = &tetromino.shape[0];
-		for (unsigned int r = 0; r < tSize; r++) {
-
-			const unsigned char* vRowTetromino = &shape[r][0];
-			for (unsigned int c = 0; c < tSize; c++) {
-				currentBlock.x = OFFSET_X + (tetromino.x + c) * BLOCK_SIZE;
-				currentBlock.y = OFFSET_Y + (tetromino.y + r) * BLOCK_SIZE;
-
-				// Don't render the top 2 lines 
-				if (tetromino.y + r < 2)
-					continue;
-
-				if (vRowTetromino[c] >= 1)
-					SDL_RenderCopy(gRenderer, gPreRendered[vRowTetromino[c]], NULL, &currentBlock);
-			}
-		}
-	}
-
-
-	// Render ghost tetromino
-	Tetromino ghost = {tetromino.x, tetromino.y, true, tetromino.shape};
-
-	while (move(ghost, fieldMat, DIR_DOWN));  // Move ghost all the way down
-
-	if (ghost.visible) {
-		unsigned int tSize = ghost.shape.size();
-		const std::vector <unsigned char>* shape = &ghost.shape[0];
-		for (unsigned int r = 0; r < tSize; r++) {
-
-			const unsigned char* vRowGhost = &shape[r][0];
-			for (unsigned int c = 0; c < tSize; c++) {
-				currentBlock.x = OFFSET_X + (ghost.x + c) * BLOCK_SIZE;
-				currentBlock.y = OFFSET_Y + (ghost.y + r) * BLOCK_SIZE;
-
-				// Don't render the top 2 lines 
-				if (ghost.y + r < 2)
-					continue;
-
-				if (vRowGhost[c] >= 1)
-					SDL_RenderCopy(gRenderer, gPreRenderedGhost[vRowGhost[c]], NULL, &currentBlock);
-			}
-		}
-	}
-
-
-	// Render next tetromino on the right
-	unsigned int tSize = nextTetromino.shape.size();
-	const std::vector<unsigned char>* shape = &nextTetromino.shape[0];
-	for (unsigned int r = 0; r < tSize; r++) {
-
-		const unsigned char* vRowTetromino = &shape[r][0];
-		for (unsigned int c = 0; c < tSize; c++) {
-			currentBlock.x = OFFSET_X_NEXT + c * BLOCK_SIZE;
-			currentBlock.y = OFFSET_Y_NEXT + r * BLOCK_SIZE;
-
-			if(vRowTetromino[c] >= 1)
-				SDL_RenderCopy(gRenderer, gPreRendered[vRowTetromino[c]], NULL, &currentBlock);
-		}
-	}
-}
-
-bool rotate(Tetromino& tetromino, const std::vector<std::vector<unsigned char>>& fieldMat){
-    /* Attemps to rotate the tetromino by 90 degrees. Returns true
-     * if the rotation is successful, or false if the rotation is
-     * impossible due to a collision */
-    unsigned int tSize = tetromino.shape.size(); 
-    std::vector<std::vector<unsigned char>> oldShape(tSize, std::vector<unsigned char>(tSize));
-    std::vector<std::vector<unsigned char>> rotShape(tSize, std::vector<unsigned char>(tSize));
-
-	// Keep old shape in case rotation fails
-    oldShape = tetromino.shape;  
-
-    for(unsigned char r = 0; r < tSize; r++)
-        for(unsigned char c = 0; c < tSize; c++){
-            rotShape[r][c] = tetromino.shape[tSize - 1 - c][r];
-        }
-    
-	/* Check rotated tetromino for collisions, try kicks if necessary*/
-    tetromino.shape = rotShape;
-    if(collidesWith(tetromino, fieldMat)){ 
-		tetromino.x++; // Attempt right kick
-		if(collidesWith(tetromino, fieldMat)){
-			tetromino.x -= 2;  // Attempt left kick
-			if (collidesWith(tetromino, fieldMat)) {
-				tetromino.x++;
-		        tetromino.shape = oldShape;
-				return false;  // Rotation failed
-
-			}
-		}
-    }
-
-	return true;
-}
-
-void renderBorder(const std::vector<std::vector<unsigned char>>& fieldMat){
-    /* Draw the border of the playing field */
-    
-    SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
-    int width = fieldMat[0].size() * BLOCK_SIZE;
-    int height = (fieldMat.size() -2) * BLOCK_SIZE;  // Top 2 rows are invisible
-    int border_offset_y = OFFSET_Y + BLOCK_SIZE * 2;
-
-    SDL_Rect leftBorder = {OFFSET_X-5, border_offset_y, 5, height};
-    SDL_RenderFillRect(gRenderer,  &leftBorder);
-
-    SDL_Rect rightBorder = {static_cast<int>(OFFSET_X) + width, border_offset_y, 5, height + 5};
-    SDL_RenderFillRect(gRenderer,  &rightBorder);
-
-    SDL_Rect topBorder = {OFFSET_X-5, border_offset_y -5, width + 10, 5};
-    SDL_RenderFillRect(gRenderer,  &topBorder);
-
-    SDL_Rect bottomBorder = {OFFSET_X-5, border_offset_y + height, width + 5, 5};
-    SDL_RenderFillRect(gRenderer,  &bottomBorder);
-}
-
-void updateTextInfo(Uint32 score){
-    std::string scoreStr = "Score " + std::to_string(score);
-
-    SDL_Color textColor{ 0, 0xFF, 0};
-    gTextTexture.loadFromRenderedText(scoreStr, textColor);
-
-    gTextTexture.render(SCREEN_WIDTH / 2 - 50, OFFSET_Y_NEXT + 125);
-}
-
-std::vector<std::vector<unsigned char>> getRandomShape(){
-    static std::stack<unsigned char> shapesBag;
-
-    // Add all shapes to the bag if its empty
-    if (shapesBag.empty()){
-        std::vector<unsigned char> shapeKeys = SHAPES_AVAILABLE;
-        std::shuffle(shapeKeys.begin(), shapeKeys.end(), std::default_random_engine(SEED));
-
-        for(unsigned char sk : shapeKeys){
-            shapesBag.push(sk);
-        }
-    }
-
-    // Pick one from the bag  
-    unsigned char pickedShape = shapesBag.top();
-    shapesBag.pop();
-    
-    return TETROMINO_SHAPES[pickedShape];
-}
-
-void freezeTetromino(const Tetromino& tetromino, std::vector<std::vector<unsigned char>>& fieldMat){
-    /* Locks the tetromino into place then spawns a new one */
-    
-    for (unsigned char r = 0; r < tetromino.shape.size(); r++)
-        for (unsigned char c = 0; c < tetromino.shape[0].size(); c++){
-            if (tetromino.shape[r][c] == 0)  // Don't copy empty cells;
-                continue;
-            else
-                fieldMat[r + tetromino.y][c + tetromino.x] = tetromino.shape[r][c];
-        }
-    
-}
-
-unsigned char flushFull(std::vector<std::vector<unsigned char>>& fieldMat){
-    /* Flushes all full rows in the field. Returns number of lines flushed*/
-    
-    unsigned char nFlushed = 0;
-    std::stack<unsigned char> flushStack;
-
-    // Place rows that must be flushed on the stack
-    for (unsigned int r = fieldMat.size() - 1; r > 0; r--){
-        bool rowFull = true;
-        for (unsigned int c = 0; c < fieldMat[0].size(); c++){
-            if (fieldMat[r][c] == 0){
-                rowFull = false;
-                break;
-            }
-
-        }
-
-        // Row can be flushed
-        if (rowFull)
-            flushStack.push(r);
-    }     
-
-    // Flush rows on the stack
-    while(!flushStack.empty()){
-        for (unsigned char r = flushStack.top(); r > 0; r--)
-            for(unsigned char c = 0; c < fieldMat[0].size(); c++)
-                fieldMat[r][c] = fieldMat[r - 1][c];
-
-        flushStack.pop();
-        nFlushed++;
-    }
-
-    return nFlushed;
-}
-
-int endTurn(Tetromino& tetromino, Tetromino& nextTetromino, std::vector<std::vector<unsigned char>>& fieldMat){
-    /* Ends current turn. Returns points scored in this turn, or returns -1 on gameOver */
-
-    // Freeze tetromino and flush
-    freezeTetromino(tetromino, fieldMat);
-    unsigned char nFlushed = flushFull(fieldMat);
-
-	// Game over if player tops out
-    for (unsigned char c = 0; c < fieldMat[0].size(); c++)
-		if (fieldMat[1][c] > 0) {
-			tetromino.visible = false;
-            return -1;
-		}
-    
-	// Copy shape of next tetromino to the active one
-    tetromino.x = 4;
-    tetromino.y = 0;
-    tetromino.shape = nextTetromino.shape;
-
-	// Obtain next tetromino
-	nextTetromino.shape = getRandomShape();
-	
-	// Game over if the tetromino can't be placed
-	if (collidesWith(tetromino, fieldMat))
-		return -1;
-
-    int turnScore = (nFlushed * nFlushed) * 100;
-    
-    return turnScore;
-}
-
-void gameLoop(){
-	InputManager playerControls;
-
-    bool quitGame = false;
-    bool gameOver = false;
-    bool shownGameOverMessage = false;
-    bool forceTick = false;
-    bool resetGame = false;
-
-    Uint32 gameTime = 0;
-    Uint32 tickTime = 1000;
-	Uint32 maxTickTime = 1000;  // Starting speed is 1 tick/s
-	
-    Uint32 playerScore = 0;
-
-    Tetromino activeTetromino = { 4, 0, true, getRandomShape() };
-	Tetromino nextTetromino = { 4, 0, true, getRandomShape() };
-
-    SDL_Delay(1000);
-    while(!quitGame){
-        gameTime = SDL_GetTicks();
-		playerControls.processInput();
-		
-		if (playerControls.getStateQuit())
-			quitGame = true;
-
-		if(gameOver){
-            if (!shownGameOverMessage){
-                std::cout << "Game Over!\n";
-                std::cout << "Press RETURN try again.\n";
-                shownGameOverMessage = true;
-            }
-
-			if (playerControls.getStateRotate())
-				resetGame = true;
-
-            if (resetGame) {
-                std::cout << "Game reset!" << std::endl;
-                playerScore = 0;
-                gameOver = false;
-                shownGameOverMessage = false;
-                gameTime = 0;
-                activeTetromino = { 4, 0, true, getRandomShape()};
-				maxTickTime = 1000;
-                
-                // Clear field
-                for (unsigned char i = 0; i < fieldMat.size(); i++)
-                    for (unsigned char j = 0; j < fieldMat[0].size(); j++)
-                        fieldMat[i][j] = 0;
-                resetGame = false;
-            }
-		}
-		else{
-			Direction direction = playerControls.getStateDirection();
-			if (direction == DIR_LEFT || direction == DIR_RIGHT || direction == DIR_DOWN)
-				move(activeTetromino, fieldMat, direction);
-
-			if (playerControls.getStateRotate())
-				rotate(activeTetromino, fieldMat);
-			
-			if (playerControls.getStateDrop()){
-				while(move(activeTetromino, fieldMat, DIR_DOWN));
-				forceTick = true;
-			}
-
-            // Game logic tick
-            if (gameTime - tickTime > maxTickTime || forceTick){
-                tickTime = gameTime;
-                forceTick = false;
-                
-                // Try to move tetromino down, end turn if blocked
-                if(!move(activeTetromino, fieldMat, DIR_DOWN)){
-                    int turnScore = endTurn(activeTetromino, nextTetromino, fieldMat);
-                    if(turnScore == -1)
-                        gameOver = true;
-                    else{
-						// Gradually speed up the game after every clear, lower cap at 50ms
-						if (turnScore > 0 && maxTickTime > 25)
-							maxTickTime -= 10;
-                        playerScore += turnScore;
-					}
-                }
-            }
-        }
-
-        // Render
-        SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xFF);
-        SDL_RenderClear(gRenderer);
-
-        renderBorder(fieldMat);
-        renderField(fieldMat, activeTetromino, nextTetromino);
-        updateTextInfo(playerScore);
-
-        SDL_RenderPresent(gRenderer); 
-        SDL_Delay(10);  // Don't run too fast
-    }
-}
-
-int main(int argc, char* args[]){
-    // Seed random generator with current time
-	std::srand(static_cast<unsigned int>(std::time(0)));
-    init();
-
-    gameLoop();
-    close();
-
-    printf("Bye!\n");
-    return 0;
-}
+#include <iostream>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <chrono>
+#include <cstdlib>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include "ai.h"
+#include "alloc_counter.h"
+#include "block_batch.h"
+#include "field_renderer.h"
+#include "frame_telemetry.h"
+#include "game.h"
+#include "glyph_atlas.h"
+#include "input.h"
+#include "replay.h"
+#include "state_feed.h"
+#include "trace.h"
+#include "versus.h"
+
+const uint64_t SEED = std::chrono::system_clock::now().time_since_epoch().count();
+
+SDL_Window* gWindow = NULL;
+SDL_Renderer* gRenderer = NULL;
+// Every connected gamepad, gamepad i plays board i of a versus match
+SDL_Joystick* gGameControllers[MAX_VERSUS_BOARDS] = {};
+unsigned int gNumGameControllers = 0;
+TTF_Font *gFont = NULL;
+
+BlockBatch gBlocks;
+GlyphAtlas gText;
+FieldRenderer gField;  // Draws the single player field with gBlocks
+
+bool gSoftwareRenderer = false;
+bool gImmediateRender = false;
+bool gShowFrameStats = false;
+bool gShowOverlay = false;      // Performance overlay shown from the start with --perf-overlay, F3 toggles it
+bool gUncapped = false;         // Present without waiting for vsync
+Uint32 gLogicStep = 5;          // ms per logic step, 200 steps/s by default
+InputTiming gInputTiming;       // --das and --arr
+std::string gReplayDir;         // Games are recorded here with --record
+std::string gTelemetryPath;     // Frame telemetry is streamed here with --telemetry
+std::string gTracePath;         // Chrome trace written here on exit with --trace
+std::string gFeedName;          // Shared memory the game state is published to with --feed
+unsigned int gVersusBoards = 0; // Boards of a versus match with --versus, 0 plays alone
+unsigned int gVersusHumans = 1; // Versus boards played by people, the rest are bots
+
+const Uint32 MAX_FRAME_INTERVAL = 1000;  // Redraw at least this often even when nothing changed
+const Uint32 MAX_CATCH_UP_STEPS = 25;
+const Uint32 OVERLAY_REFRESH = 250;      // ms between updates of the overlay numbers
+
+#ifdef TETRIS_COUNT_ALLOCS
+const unsigned int ALLOC_WARMUP_PIECES = 2;  // Placements before a game must stop allocating
+#endif
+
+uint64_t nowMicros(){
+    // Performance counter in microseconds, split so the multiplication can't overflow
+    Uint64 counter = SDL_GetPerformanceCounter();
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    return counter / frequency * 1000000 + counter % frequency * 1000000 / frequency;
+}
+
+// Stage times of the frame being drawn, the overlay and --telemetry report them
+FrameSample gFrameSample;
+uint64_t gStageStart = 0;
+
+void endStage(FrameStage stage){
+    // Charges the time since the previous stage ended to this one
+    uint64_t now = nowMicros();
+    gFrameSample.stages[stage] += static_cast<uint32_t>(now - gStageStart);
+    gStageStart = now;
+}
+
+/* Calls queue(action, pressed) for every gameplay key or button that the
+ * event presses or releases. prevHat is the last D-pad state of the
+ * gamepad the event came from */
+template<class Queue>
+void translateEvent(const SDL_Event& event, Uint8& prevHat, Queue queue){
+	// Keyboard, the decoder does its own repeating so key repeats are ignored
+	if ((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && !event.key.repeat){
+		bool pressed = event.type == SDL_KEYDOWN;
+		switch(event.key.keysym.sym){
+			case SDLK_LEFT:
+				queue(INPUT_LEFT, pressed);
+				break;
+			case SDLK_RIGHT:
+				queue(INPUT_RIGHT, pressed);
+				break;
+			case SDLK_DOWN:
+				queue(INPUT_DOWN, pressed);
+				break;
+			case SDLK_LSHIFT:
+			case SDLK_RETURN:
+				queue(INPUT_ROTATE, pressed);
+				break;
+			case SDLK_SPACE:
+				queue(INPUT_DROP, pressed);
+				break;
+		}
+	}
+
+	// Gamepad Buttons
+	else if (event.type == SDL_JOYBUTTONDOWN || event.type == SDL_JOYBUTTONUP){
+		bool pressed = event.type == SDL_JOYBUTTONDOWN;
+		if(event.jbutton.button == 0)
+			queue(INPUT_DROP, pressed);
+		else if(event.jbutton.button == 1)
+			queue(INPUT_ROTATE, pressed);
+	}
+
+	// Gamepad D-pad, one event carries the whole hat so compare with the previous state
+	else if (event.type == SDL_JOYHATMOTION){
+		const Uint8 hatBits[3] = {SDL_HAT_LEFT, SDL_HAT_RIGHT, SDL_HAT_DOWN};
+		const InputAction hatActions[3] = {INPUT_LEFT, INPUT_RIGHT, INPUT_DOWN};
+
+		for (int i = 0; i < 3; i++)
+			if ((event.jhat.value ^ prevHat) & hatBits[i])
+				queue(hatActions[i], (event.jhat.value & hatBits[i]) != 0);
+		prevHat = event.jhat.value;
+	}
+}
+
+/* Gameplay keys and buttons are captured by an event watch the moment SDL
+ * reads them from the system, stamped with the performance counter and
+ * queued for the logic steps. The SDL event queue itself is only polled
+ * for quitting and toggling the autopilot and the performance overlay */
+class InputManager {
+	private:
+		SDL_Event e;
+		
+		bool stateQuit = false;
+		bool stateAutopilot = false;
+		bool stateOverlay;
+
+		// Timestamp of the latest press not yet shown on screen
+		Uint32 pressTime = 0;
+		bool pressPending = false;
+
+		/* SDL calls the event watch from the thread that pumps events, which
+		 * is the main thread, so the queue has a single producer */
+		InputQueue queue;
+		InputDecoder decoder;
+		Uint8 prevHat = SDL_HAT_CENTERED;
+		unsigned int droppedEvents = 0;
+
+		// Inputs sent by another process through the --feed shared memory
+		StateFeed* feed = NULL;
+
+		static int captureEvent(void* userdata, SDL_Event* event);
+		void capture(const SDL_Event& event);
+		void queueEvent(InputAction action, bool pressed);
+
+	public:
+		// Builds the input of the logic step ending at stepEnd (microseconds)
+		GameInput nextStep(uint64_t stepEnd);
+		void resetInput();
+		void setFeed(StateFeed* stateFeed);
+
+		bool getStateQuit();
+		bool getStateAutopilot();
+		bool getStateOverlay();
+		bool takePressTime(Uint32& time);
+		unsigned int takeDroppedEvents();
+
+		void processInput();
+
+		InputManager(const InputTiming& timing, bool overlay);
+		~InputManager();
+};
+
+InputManager::InputManager(const InputTiming& timing, bool overlay) : stateOverlay(overlay), decoder(timing){
+	SDL_AddEventWatch(captureEvent, this);
+}
+
+InputManager::~InputManager(){
+	SDL_DelEventWatch(captureEvent, this);
+}
+
+int InputManager::captureEvent(void* userdata, SDL_Event* event){
+	static_cast<InputManager*>(userdata)->capture(*event);
+	return 0;
+}
+
+void InputManager::queueEvent(InputAction action, bool pressed){
+	/* Stamped when SDL hands the event to the watch, which happens while the
+	 * main thread pumps events, once per frame. Press and release times are
+	 * therefore only as exact as the frame they were pumped in. The queue
+	 * still keeps presses shorter than a frame, and the decoder times
+	 * repeats from these stamps rather than from the logic steps */
+	InputEvent event = {nowMicros(), static_cast<unsigned char>(action), pressed};
+	if (!queue.push(event))
+		droppedEvents++;
+}
+
+void InputManager::capture(const SDL_Event& event){
+	translateEvent(event, prevHat, [this](InputAction action, bool pressed){ queueEvent(action, pressed); });
+}
+
+GameInput InputManager::nextStep(uint64_t stepEnd){
+	return decoder.step(queue, stepEnd);
+}
+
+void InputManager::resetInput(){
+	// Forgets held keys and pending presses, the queue is drained up to now
+	InputEvent event;
+	while (queue.pop(event));
+	decoder.reset();
+}
+
+void InputManager::setFeed(StateFeed* stateFeed){
+	feed = stateFeed;
+}
+
+bool InputManager::getStateQuit(){
+	return stateQuit;
+}
+
+bool InputManager::getStateAutopilot(){
+	return stateAutopilot;
+}
+
+bool InputManager::getStateOverlay(){
+	return stateOverlay;
+}
+
+bool InputManager::takePressTime(Uint32& time){
+	/* Hands out the time of the latest press once, for latency measurement */
+	if (!pressPending)
+		return false;
+
+	time = pressTime;
+	pressPending = false;
+	return true;
+}
+
+unsigned int InputManager::takeDroppedEvents(){
+	unsigned int dropped = droppedEvents;
+	droppedEvents = 0;
+	return dropped;
+}
+
+void InputManager::processInput(){
+	TRACE_SCOPE("processInput");
+	while (SDL_PollEvent(&e) != 0){
+		// Window close event
+		if (e.type == SDL_QUIT)
+			stateQuit = true;
+
+		// Keyboard
+		else if (e.type == SDL_KEYDOWN){
+			if (!e.key.repeat){
+				pressTime = e.key.timestamp;
+				pressPending = true;
+			}
+
+			if (e.key.keysym.sym == SDLK_a && !e.key.repeat)
+				stateAutopilot = !stateAutopilot;
+			else if (e.key.keysym.sym == SDLK_F3 && !e.key.repeat)
+				stateOverlay = !stateOverlay;
+		}
+
+		// Gamepad
+		else if (e.type == SDL_JOYBUTTONDOWN){
+			pressTime = e.jbutton.timestamp;
+			pressPending = true;
+		}
+		else if (e.type == SDL_JOYHATMOTION && e.jhat.value != SDL_HAT_CENTERED){
+			pressTime = e.jhat.timestamp;
+			pressPending = true;
+		}
+	}
+
+	/* Stamped on arrival like device events, so they go through the same
+	 * decoder. At most one ring of them per frame, whatever the reader does */
+	uint64_t time = nowMicros();
+	InputAction action;
+	bool pressed;
+	for (size_t i = 0; i < STATE_FEED_INPUT_SIZE && feed != NULL && feed->popInput(time, action, pressed); i++){
+		InputEvent event = {time, static_cast<unsigned char>(action), pressed};
+		if (!queue.push(event))
+			droppedEvents++;
+	}
+}
+
+bool loadFonts(){
+    gFont = TTF_OpenFont("consola.ttf", 24);
+    if(gFont == NULL){
+        printf("Could not load font! SDL_ttf Error: %s\n", TTF_GetError());
+        return false;
+    }
+    
+    return true;
+}
+
+bool init(){
+    bool success = true;
+    if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) < 0){
+        printf("SDL Could not initialize! SDL Error: %s\n", SDL_GetError());
+        success = false;
+    }
+    else{
+        gWindow = SDL_CreateWindow("Tetris Clone", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL);
+        if(gWindow == NULL){
+            printf("Could not create window! SDL Error: %s\n", SDL_GetError());
+            success = false;
+        }
+        else{
+            gRenderer = SDL_CreateRenderer(gWindow, -1,
+                    (gSoftwareRenderer ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED)
+                    | (gUncapped ? 0 : SDL_RENDERER_PRESENTVSYNC));
+            if (gRenderer == NULL){
+                printf("Could not create renderer: %s\n", SDL_GetError());
+                success = false;
+            }
+            else{
+                SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xFF);
+            }
+        }
+    }
+
+    if(TTF_Init() == -1){
+        printf("SDL_ttf could not be initialized! SDL_ttf Error: %s\n", TTF_GetError());
+        return false;
+    }
+
+    if(!loadFonts()){
+        printf("Could not load font! \n");
+        return false;
+    }
+
+    // Rasterize the font once, text is drawn from the atlas afterwards
+    if(!gText.init(gRenderer, gFont)){
+        printf("Could not create glyph atlas! \n");
+        return false;
+    }
+
+    int numJoysticks = SDL_NumJoysticks();
+    for (int i = 0; i < numJoysticks && gNumGameControllers < MAX_VERSUS_BOARDS; i++){
+        SDL_Joystick* controller = SDL_JoystickOpen(i);
+        if (controller != NULL)
+            gGameControllers[gNumGameControllers++] = controller;
+    }
+    if(gNumGameControllers == 0){
+        printf("No game controllers detected: %s\n", SDL_GetError());
+    }
+
+    // Pre render all blocks into one atlas
+    if(!gBlocks.init(gRenderer, BLOCK_SIZE)){
+        printf("Could not create block textures! \n");
+        return false;
+    }
+
+    // Retained layer for the locked field, draw everything every frame without it
+    gField.init(gRenderer, &gBlocks, !gImmediateRender);
+    gField.setStageHook(endStage);
+
+    return success;
+}
+
+void close(){
+    // Free textures and fonts
+    gText.free();
+    TTF_CloseFont(gFont);
+    gFont = NULL;
+    gBlocks.free();
+    gField.free();
+    
+    // Destroy renderer
+    SDL_DestroyRenderer(gRenderer);
+    gRenderer = NULL;
+    SDL_DestroyWindow(gWindow);
+    gWindow = NULL;
+    
+    // Close joysticks
+    for (unsigned int i = 0; i < gNumGameControllers; i++){
+        SDL_JoystickClose(gGameControllers[i]);
+        gGameControllers[i] = NULL;
+    }
+    gNumGameControllers = 0;
+    
+    // Quit subsystems
+    TTF_Quit();
+    SDL_Quit();
+}
+
+// Performance overlay text, formatted every OVERLAY_REFRESH ms and drawn every frame
+const unsigned int OVERLAY_LINES = 5 + NUM_FRAME_STAGES;
+char gOverlayText[OVERLAY_LINES][32];
+
+void formatOverlay(const FrameSummary& summary){
+    snprintf(gOverlayText[0], sizeof(gOverlayText[0]), "frame p50 %6.2f ms", summary.intervalP50 / 1000.0);
+    snprintf(gOverlayText[1], sizeof(gOverlayText[1]), "      p99 %6.2f ms", summary.intervalP99 / 1000.0);
+    snprintf(gOverlayText[2], sizeof(gOverlayText[2]), "      max %6.2f ms", summary.intervalMax / 1000.0);
+    snprintf(gOverlayText[3], sizeof(gOverlayText[3]), "draw calls %7.1f", summary.drawCalls);
+    snprintf(gOverlayText[4], sizeof(gOverlayText[4]), "allocs     %7.1f", summary.allocations);
+    for (int s = 0; s < NUM_FRAME_STAGES; s++)
+        snprintf(gOverlayText[5 + s], sizeof(gOverlayText[5 + s]), "%-8s %6.2f ms",
+                frameStageName(static_cast<FrameStage>(s)), summary.stageMean[s] / 1000.0);
+}
+
+void addOverlayText(){
+    // Queued with the score, so both are drawn in the same batch
+    SDL_Color overlayColor{ 0xFF, 0xFF, 0, 0xFF};
+    for (unsigned int i = 0; i < OVERLAY_LINES; i++)
+        gText.addText(gOverlayText[i], SCREEN_WIDTH - 250, 10 + 26 * i, overlayColor);
+}
+
+void updateTextInfo(Uint32 score){
+    TRACE_SCOPE("updateTextInfo");
+    char scoreStr[32];
+    snprintf(scoreStr, sizeof(scoreStr), "Score %u", score);
+
+    SDL_Color textColor{ 0, 0xFF, 0, 0xFF};
+    gText.addText(scoreStr, SCREEN_WIDTH / 2 - 50, OFFSET_Y_NEXT + 125, textColor);
+    gText.flush();
+}
+
+// Everything a frame shows, frames are only drawn when this changes
+struct FrameState {
+    uint32_t fieldRevision;
+    Tetromino active;
+    unsigned char nextShape;
+    Uint32 score;
+    bool overlay;
+};
+
+bool sameFrame(const FrameState& a, const FrameState& b){
+    return a.fieldRevision == b.fieldRevision
+        && a.active.x == b.active.x && a.active.y == b.active.y
+        && a.active.visible == b.active.visible
+        && a.active.shape == b.active.shape && a.active.rotation == b.active.rotation
+        && a.nextShape == b.nextShape
+        && a.score == b.score
+        && a.overlay == b.overlay;
+}
+
+unsigned int renderFrame(const GameState& game, bool overlay){
+    /* Draws and presents one frame. Returns the number of draw calls
+     * made outside of the block and text batches. The time each part
+     * takes is added to gFrameSample */
+    TRACE_SCOPE("renderFrame");
+    unsigned int otherDrawCalls = gField.draw(game.field(), game.activeTetromino(), game.nextTetromino());
+
+    if (overlay)
+        addOverlayText();
+    updateTextInfo(game.score());
+    endStage(STAGE_TEXT);
+
+    {
+        TRACE_SCOPE("SDL_RenderPresent");
+        SDL_RenderPresent(gRenderer);
+    }
+    endStage(STAGE_PRESENT);
+
+    return otherDrawCalls;
+}
+
+void startRecording(ReplayRecorder& recorder, const GameState& game){
+    if (gReplayDir.empty())
+        return;
+
+    std::string path = gReplayDir + "/" + std::to_string(game.seed()) + ".trp";
+    if (!recorder.begin(path.c_str(), {game.seed(), PIECES_BAG7, static_cast<uint16_t>(gLogicStep)}))
+        printf("Game will not be recorded\n");
+}
+
+void gameLoop(){
+	InputManager playerControls(gInputTiming, gShowOverlay);
+	// Every game gets its own seed, so each recording can be replayed on its own
+	uint64_t seedState = SEED;
+	GameState game(splitMix64(seedState));
+	ReplayRecorder recorder;
+	startRecording(recorder, game);
+
+	Bot bot;
+	Autopilot autopilot(bot, std::chrono::milliseconds(5));
+
+    bool quitGame = false;
+    bool shownGameOverMessage = false;
+
+    /* The game advances in fixed logic steps, rendering runs as often as
+     * the display (or --uncapped) allows. simTime is the end of the last
+     * step that ran, each step takes the input events captured up to its
+     * own end time, so inputs land in the step they happened in even when
+     * several steps run back to back after a frame */
+    const Uint32 logicStep = gLogicStep;
+    const uint64_t stepMicros = logicStep * 1000ull;
+
+    // Render cost and latency, reported once per second with --frame-stats
+    Uint32 statsTime = SDL_GetTicks();
+    Uint32 statsFrames = 0;
+    Uint32 statsSkipped = 0;
+    Uint32 statsSteps = 0;
+    Uint64 statsRenderTicks = 0;
+    Uint64 statsDrawCalls = 0;
+    Uint32 statsLatencySum = 0;
+    Uint32 statsLatencyMax = 0;
+    Uint32 statsLatencyCount = 0;
+    Uint32 statsDroppedInputs = 0;
+
+    // Every presented frame goes to the overlay's window and, with --telemetry, the file
+    FrameHistory frameHistory;
+    TelemetryWriter telemetry;
+    if (!gTelemetryPath.empty() && !telemetry.open(gTelemetryPath.c_str()))
+        printf("Frame telemetry will not be written\n");
+    uint64_t framesPresented = 0;
+    uint64_t presentAllocations = 0;
+    uint64_t telemetryStart = 0;
+    uint64_t lastPresent = 0;
+    Uint32 overlayTime = 0;
+
+    // Every logic step is published for other processes with --feed
+    StateFeed feed;
+    if (!gFeedName.empty()){
+        if (feed.open(gFeedName.c_str())){
+            playerControls.setFeed(&feed);
+            feed.publish(game, 0);
+        }
+        else
+            printf("The game state will not be published\n");
+    }
+
+    FrameState lastFrame = {};
+    Uint32 lastFrameTime = 0;
+    bool frameDrawn = false;
+
+    SDL_Delay(1000);
+    playerControls.processInput();
+    playerControls.resetInput();
+    uint64_t simTime = nowMicros();
+    telemetryStart = lastPresent = simTime;
+    presentAllocations = allocationCount();
+    gFrameSample = FrameSample();
+#ifdef TETRIS_COUNT_ALLOCS
+    unsigned int gamesStarted = 0;
+    uint64_t statsAllocations = 0;
+#endif
+    while(!quitGame){
+        TRACE_SCOPE("frame");
+#ifdef TETRIS_COUNT_ALLOCS
+        /* Frames in the middle of a game must not allocate anywhere, on this
+         * thread or the bot's. Starting and ending games may */
+        uint64_t frameAllocations = allocationCount();
+        unsigned int frameGame = gamesStarted;
+        bool steadyFrame = game.placedCount() >= ALLOC_WARMUP_PIECES && !game.isGameOver();
+#endif
+        gStageStart = nowMicros();
+		playerControls.processInput();
+		
+		if (playerControls.getStateQuit())
+			quitGame = true;
+        endStage(STAGE_INPUT);
+
+        uint64_t now = nowMicros();
+
+        // Don't try to catch up on more than a few steps after a stall
+        if (now - simTime > MAX_CATCH_UP_STEPS * stepMicros)
+            simTime = now - MAX_CATCH_UP_STEPS * stepMicros;
+
+        while (now - simTime >= stepMicros){
+            TRACE_SCOPE("logic step");
+            simTime += stepMicros;
+            statsSteps++;
+            gFrameSample.logicSteps++;
+
+            // Always consumed, so the queue doesn't back up while the autopilot or game over screen is on
+            GameInput playerInput = playerControls.nextStep(simTime);
+
+            if(game.isGameOver()){
+                if (!shownGameOverMessage){
+                    std::cout << "Game Over!\n";
+                    std::cout << "Press RETURN try again.\n";
+                    shownGameOverMessage = true;
+                    recorder.finish(game);
+                }
+
+                if (playerInput.rotate) {
+                    std::cout << "Game reset!" << std::endl;
+                    shownGameOverMessage = false;
+                    game = GameState(splitMix64(seedState));
+                    startRecording(recorder, game);
+#ifdef TETRIS_COUNT_ALLOCS
+                    gamesStarted++;
+#endif
+                }
+            }
+            else{
+                GameInput input = playerControls.getStateAutopilot() ? autopilot.nextInput(game) : playerInput;
+                recorder.step(input);
+                game.step(input, logicStep);
+            }
+
+            feed.publish(game, simTime);
+        }
+
+        endStage(STAGE_LOGIC);
+
+        // Render, skipping frames that would look exactly like the last one
+        Uint32 gameTime = SDL_GetTicks();
+        bool overlay = playerControls.getStateOverlay();
+        FrameState frame = { game.field().revision(), game.activeTetromino(), game.nextTetromino().shape, game.score(), overlay };
+        bool refreshOverlay = overlay && (!lastFrame.overlay || gameTime - overlayTime >= OVERLAY_REFRESH);
+        bool redraw = !frameDrawn || !sameFrame(frame, lastFrame) || gameTime - lastFrameTime >= MAX_FRAME_INTERVAL || refreshOverlay;
+
+        if (redraw){
+            Uint64 renderStart = SDL_GetPerformanceCounter();
+            if (refreshOverlay){
+                formatOverlay(frameHistory.summarize());
+                overlayTime = gameTime;
+                endStage(STAGE_TEXT);
+            }
+            unsigned int otherDrawCalls = renderFrame(game, overlay);
+
+            lastFrame = frame;
+            lastFrameTime = gameTime;
+            frameDrawn = true;
+
+            // Time from the last key or button press to the first frame presented after it
+            Uint32 pressTime;
+            if (playerControls.takePressTime(pressTime)){
+                Uint32 latency = SDL_GetTicks() - pressTime;
+                statsLatencySum += latency;
+                statsLatencyCount++;
+                if (latency > statsLatencyMax)
+                    statsLatencyMax = latency;
+            }
+
+            statsRenderTicks += SDL_GetPerformanceCounter() - renderStart;
+            statsDrawCalls += gBlocks.drawCalls() + gText.drawCalls() + otherDrawCalls;
+            statsFrames++;
+
+            // The present stage ended when SDL_RenderPresent returned
+            uint64_t allocations = allocationCount();
+            gFrameSample.frame = framesPresented++;
+            gFrameSample.time = gStageStart - telemetryStart;
+            gFrameSample.interval = static_cast<uint32_t>(gStageStart - lastPresent);
+            gFrameSample.drawCalls = gBlocks.drawCalls() + gText.drawCalls() + otherDrawCalls;
+            gFrameSample.allocations = static_cast<uint32_t>(allocations - presentAllocations);
+            frameHistory.add(gFrameSample);
+            telemetry.write(gFrameSample);
+
+            lastPresent = gStageStart;
+            presentAllocations = allocations;
+            gFrameSample = FrameSample();
+        }
+        else {
+            statsSkipped++;
+
+            // Nothing to present, so vsync won't pace the loop. Yield until the next step is due
+            if (!gUncapped)
+                SDL_Delay(1);
+        }
+
+        if (gShowFrameStats && gameTime - statsTime >= 1000){
+            double msPerFrame = statsFrames ? 1000.0 * statsRenderTicks / SDL_GetPerformanceFrequency() / statsFrames : 0;
+            double callsPerFrame = statsFrames ? static_cast<double>(statsDrawCalls) / statsFrames : 0;
+            printf("%u frames drawn, %u skipped, %u logic steps, render %.3f ms/frame, %.1f draw calls/frame",
+                    statsFrames, statsSkipped, statsSteps, msPerFrame, callsPerFrame);
+            if (statsLatencyCount > 0)
+                printf(", input-to-present %.1f ms avg, %u ms max", static_cast<double>(statsLatencySum) / statsLatencyCount, statsLatencyMax);
+#ifdef TETRIS_COUNT_ALLOCS
+            printf(", %llu allocations", static_cast<unsigned long long>(statsAllocations));
+            statsAllocations = 0;
+#endif
+            statsDroppedInputs += playerControls.takeDroppedEvents();
+            if (statsDroppedInputs > 0)
+                printf(", %u input events dropped", statsDroppedInputs);
+            printf("\n");
+
+            statsTime = gameTime;
+            statsFrames = 0;
+            statsSkipped = 0;
+            statsSteps = 0;
+            statsRenderTicks = 0;
+            statsDrawCalls = 0;
+            statsLatencySum = 0;
+            statsLatencyMax = 0;
+            statsLatencyCount = 0;
+            statsDroppedInputs = 0;
+        }
+        gBlocks.resetDrawCalls();
+        gText.resetDrawCalls();
+
+#ifdef TETRIS_COUNT_ALLOCS
+        frameAllocations = allocationCount() - frameAllocations;
+        statsAllocations += frameAllocations;
+        if (steadyFrame && !game.isGameOver() && gamesStarted == frameGame)
+            checkNoAllocations(frameAllocations, "during a gameplay frame");
+#endif
+    }
+
+    // A game quit halfway is still a complete recording up to this point
+    recorder.finish(game);
+    telemetry.close();
+}
+
+/* Routes gameplay events to the boards of a versus match. The keyboard
+ * and the first gamepad play board 0, every other gamepad the board with
+ * its index. Events for boards played by bots are dropped. Like
+ * InputManager this runs in an event watch, on the thread that pumps
+ * events, which makes it the only producer of every board's queue */
+class VersusInput {
+	public:
+		VersusInput(){
+			SDL_AddEventWatch(captureEvent, this);
+		}
+
+		~VersusInput(){
+			SDL_DelEventWatch(captureEvent, this);
+		}
+
+		void setMatch(VersusMatch* match){
+			mMatch = match;
+			for (Uint8& hat : mPrevHat)
+				hat = SDL_HAT_CENTERED;
+		}
+
+	private:
+		VersusMatch* mMatch = NULL;
+		Uint8 mPrevHat[MAX_VERSUS_BOARDS];
+
+		static int captureEvent(void* userdata, SDL_Event* event){
+			static_cast<VersusInput*>(userdata)->capture(*event);
+			return 0;
+		}
+
+		void capture(const SDL_Event& event){
+			if (mMatch == NULL)
+				return;
+
+			int board = 0;
+			if (event.type == SDL_JOYBUTTONDOWN || event.type == SDL_JOYBUTTONUP || event.type == SDL_JOYHATMOTION){
+				SDL_JoystickID which = event.type == SDL_JOYHATMOTION ? event.jhat.which : event.jbutton.which;
+				board = -1;
+				for (unsigned int i = 0; i < gNumGameControllers; i++)
+					if (SDL_JoystickInstanceID(gGameControllers[i]) == which)
+						board = i;
+			}
+			if (board < 0 || static_cast<unsigned int>(board) >= mMatch->boards() || !mMatch->isHuman(board))
+				return;
+
+			InputQueue& queue = mMatch->input(board);
+			translateEvent(event, mPrevHat[board], [&queue](InputAction action, bool pressed){
+				queue.push({nowMicros(), static_cast<unsigned char>(action), pressed});
+			});
+		}
+};
+
+// Where each board of a versus match is drawn, rows of up to 4 boards
+struct VersusLayout {
+	int cell;  // Block size, px
+	int boardX[MAX_VERSUS_BOARDS];  // Left edge of the field
+	int boardY[MAX_VERSUS_BOARDS];  // Top of the first visible row
+};
+
+const int VERSUS_BOARDS_PER_ROW = 4;
+const int VERSUS_BOARD_CELLS = FIELD_COLS + 7;  // Garbage meter, field, gaps and the next tetromino
+const int VERSUS_VISIBLE_ROWS = FIELD_ROWS - FIELD_HIDDEN_ROWS;
+const int VERSUS_TEXT_HEIGHT = 60;  // Two lines of text below each board
+
+VersusLayout versusLayout(unsigned int boards){
+	VersusLayout layout;
+	int perRow = boards <= static_cast<unsigned int>(VERSUS_BOARDS_PER_ROW) ? boards : (boards + 1) / 2;
+	int nRows = (boards + perRow - 1) / perRow;
+
+	int cellX = SCREEN_WIDTH / (perRow * VERSUS_BOARD_CELLS);
+	int cellY = (SCREEN_HEIGHT / nRows - VERSUS_TEXT_HEIGHT) / (VERSUS_VISIBLE_ROWS + 1);
+	layout.cell = cellX < cellY ? cellX : cellY;
+
+	int boardWidth = VERSUS_BOARD_CELLS * layout.cell;
+	int boardHeight = (VERSUS_VISIBLE_ROWS + 1) * layout.cell + VERSUS_TEXT_HEIGHT;
+	int marginX = (SCREEN_WIDTH - perRow * boardWidth) / 2;
+	for (unsigned int b = 0; b < boards; b++){
+		layout.boardX[b] = marginX + (b % perRow) * boardWidth + 2 * layout.cell;
+		layout.boardY[b] = (b / perRow) * boardHeight + layout.cell;
+	}
+
+	return layout;
+}
+
+BlockBatch gVersusBlocks;  // Same atlas as gBlocks, at the block size of the versus layout
+
+void queueVersusTetromino(const Tetromino& tetromino, int x, int y, int cell, bool ghost){
+	// x and y are where the top left of the piece grid goes, hidden rows are skipped
+	unsigned int tSize = tetrominoSize(tetromino);
+	const uint16_t* rows = tetrominoRows(tetromino);
+	unsigned char color = tetrominoColor(tetromino);
+	for (unsigned int r = 0; r < tSize; r++){
+		if (tetromino.y + static_cast<int>(r) < FIELD_HIDDEN_ROWS)
+			continue;
+		for (unsigned int c = 0; c < tSize; c++)
+			if (rows[r] & (1u << c))
+				gVersusBlocks.addBlock(x + c * cell, y + r * cell, color, ghost);
+	}
+}
+
+void renderVersus(const VersusMatch& match, const VersusLayout& layout){
+	/* Draws every board in one pass: one call for all borders, one for
+	 * the garbage meters, one batch for all blocks and one for all text */
+	TRACE_SCOPE("renderVersus");
+	const int cell = layout.cell;
+	const int width = FIELD_COLS * cell;
+	const int height = VERSUS_VISIBLE_ROWS * cell;
+
+	SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xFF);
+	SDL_RenderClear(gRenderer);
+
+	SDL_Rect borders[4 * MAX_VERSUS_BOARDS];
+	SDL_Rect meters[MAX_VERSUS_BOARDS];
+	unsigned int nMeters = 0;
+	int winner = match.winner();
+
+	for (unsigned int b = 0; b < match.boards(); b++){
+		const BoardView& view = match.view(b);
+		int x = layout.boardX[b];
+		int y = layout.boardY[b];
+
+		borders[4 * b] = {x - 3, y - 3, 3, height + 6};             // Left
+		borders[4 * b + 1] = {x + width, y - 3, 3, height + 6};     // Right
+		borders[4 * b + 2] = {x, y - 3, width, 3};                  // Top
+		borders[4 * b + 3] = {x, y + height, width, 3};             // Bottom
+
+		// Incoming garbage as a bar growing up from the bottom left of the field
+		if (view.pendingGarbage > 0){
+			int meter = view.pendingGarbage < VERSUS_VISIBLE_ROWS ? view.pendingGarbage * cell : height;
+			meters[nMeters++] = {x - 3 - cell / 2, y + height - meter, cell / 2 - 1, meter};
+		}
+
+		// Field rows are drawn from the first visible one
+		int fieldY = y - FIELD_HIDDEN_ROWS * cell;
+		for (unsigned int r = FIELD_HIDDEN_ROWS; r < FIELD_ROWS; r++)
+			for (unsigned int c = 0; c < FIELD_COLS; c++)
+				if (view.colors[r][c] > 0)
+					gVersusBlocks.addBlock(x + c * cell, fieldY + r * cell, view.colors[r][c]);
+
+		if (view.active.visible){
+			Tetromino ghost = view.active;
+			ghost.y = view.landingRow;
+			queueVersusTetromino(ghost, x + ghost.x * cell, fieldY + ghost.y * cell, cell, true);
+			queueVersusTetromino(view.active, x + view.active.x * cell, fieldY + view.active.y * cell, cell, false);
+		}
+
+		Tetromino next = {};
+		next.shape = view.nextShape;
+		next.y = FIELD_HIDDEN_ROWS;
+		queueVersusTetromino(next, x + width + cell, y, cell, false);
+
+		char line[32];
+		snprintf(line, sizeof(line), "%s%u %u", match.isHuman(b) ? "P" : "CPU", b + 1, view.score);
+		gText.addText(line, x, y + height + 6, SDL_Color{0, 0xFF, 0, 0xFF});
+		if (view.gameOver || static_cast<int>(b) == winner){
+			snprintf(line, sizeof(line), "%s", static_cast<int>(b) == winner ? "WINNER" : "OUT");
+			gText.addText(line, x, y + height + 32, SDL_Color{0xFF, 0xFF, 0, 0xFF});
+		}
+	}
+
+	SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+	SDL_RenderFillRects(gRenderer, borders, 4 * match.boards());
+	if (nMeters > 0){
+		SDL_SetRenderDrawColor(gRenderer, 0xFF, 0x00, 0x00, 0xFF);
+		SDL_RenderFillRects(gRenderer, meters, nMeters);
+	}
+
+	gVersusBlocks.flush();
+	gText.flush();
+
+	{
+		TRACE_SCOPE("SDL_RenderPresent");
+		SDL_RenderPresent(gRenderer);
+	}
+}
+
+void versusLoop(){
+	// Every match gets its own seed, like every single player game
+	uint64_t seedState = SEED;
+	VersusConfig config;
+	config.boards = gVersusBoards;
+	config.humans = gVersusHumans;
+	config.seed = splitMix64(seedState);
+	config.stepMs = gLogicStep;
+	config.timing = gInputTiming;
+	config.clock = nowMicros;
+
+	// The match clamps the number of boards
+	std::unique_ptr<VersusMatch> match(new VersusMatch(config));
+	VersusLayout layout = versusLayout(match->boards());
+	if (!gVersusBlocks.init(gRenderer, layout.cell)){
+		printf("Could not create block textures! \n");
+		return;
+	}
+
+	VersusInput input;
+	input.setMatch(match.get());
+	match->start();
+
+	/* The boards step on their own threads, this thread only routes input
+	 * and draws. A frame is drawn whenever any board published a change */
+	bool quit = false;
+	bool announced = false;
+	Uint32 lastFrameTime = 0;
+	SDL_Event e;
+	while (!quit){
+		while (SDL_PollEvent(&e) != 0){
+			if (e.type == SDL_QUIT)
+				quit = true;
+
+			// RETURN starts the next match once this one is decided
+			else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_RETURN && !e.key.repeat && match->isOver()){
+				input.setMatch(NULL);
+				config.seed = splitMix64(seedState);
+				match.reset(new VersusMatch(config));
+				input.setMatch(match.get());
+				match->start();
+				announced = false;
+			}
+		}
+
+		bool changed = false;
+		for (unsigned int b = 0; b < match->boards(); b++)
+			changed |= match->updateView(b);
+
+		if (match->isOver() && !announced){
+			if (match->winner() >= 0)
+				printf("Board %d wins! Press RETURN for a rematch.\n", match->winner() + 1);
+			else
+				printf("Nobody wins! Press RETURN for a rematch.\n");
+			announced = true;
+			changed = true;
+		}
+
+		Uint32 time = SDL_GetTicks();
+		if (changed || time - lastFrameTime >= MAX_FRAME_INTERVAL){
+			renderVersus(*match, layout);
+			lastFrameTime = time;
+		}
+		else if (!gUncapped)
+			SDL_Delay(1);
+
+		gVersusBlocks.resetDrawCalls();
+		gText.resetDrawCalls();
+	}
+
+	input.setMatch(NULL);
+	match->stop();
+	gVersusBlocks.free();
+}
+
+int main(int argc, char* args[]){
+    // Seed random generator with current time
+	std::srand(static_cast<unsigned int>(std::time(0)));
+
+    for (int i = 1; i < argc; i++){
+        std::string arg = args[i];
+        if (arg == "--software")
+            gSoftwareRenderer = true;
+        else if (arg == "--frame-stats")
+            gShowFrameStats = true;
+        else if (arg == "--perf-overlay")
+            gShowOverlay = true;
+        else if (arg == "--telemetry" && i + 1 < argc)
+            gTelemetryPath = args[++i];
+        else if (arg == "--immediate")
+            gImmediateRender = true;
+        else if (arg == "--uncapped")
+            gUncapped = true;
+        else if (arg == "--logic-hz" && i + 1 < argc){
+            int hz = std::atoi(args[++i]);
+            if (hz > 0)
+                gLogicStep = 1000 / hz > 0 ? 1000 / hz : 1;
+        }
+        else if (arg == "--das" && i + 1 < argc)
+            gInputTiming.das = std::atoi(args[++i]);
+        else if (arg == "--arr" && i + 1 < argc)
+            gInputTiming.arr = std::atoi(args[++i]);
+        else if (arg == "--record" && i + 1 < argc)
+            gReplayDir = args[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            gTracePath = args[++i];
+        else if (arg == "--feed" && i + 1 < argc)
+            gFeedName = args[++i];
+        else if (arg == "--versus" && i + 1 < argc)
+            gVersusBoards = std::atoi(args[++i]);
+        else if (arg == "--humans" && i + 1 < argc)
+            gVersusHumans = std::atoi(args[++i]);
+    }
+
+    init();
+
+    if (gVersusBoards > 0)
+        versusLoop();
+    else
+        gameLoop();
+
+    if (!gTracePath.empty()){
+#ifdef TETRIS_TRACE
+        writeTrace(gTracePath.c_str());
+#else
+        printf("Built without TETRIS_TRACE, no trace written\n");
+#endif
+    }
+    close();
+
+    printf("Bye!\n");
+    return 0;
+}
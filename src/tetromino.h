@@ -0,0 +1,123 @@
+#ifndef TETRIS_TETROMINO_H
+#define TETRIS_TETROMINO_H
+
+#include <cstdint>
+#include <type_traits>
+
+enum ShapeId : unsigned char {
+    SHAPE_T, SHAPE_B, SHAPE_S, SHAPE_Z, SHAPE_L, SHAPE_J, SHAPE_I, NUM_SHAPES
+};
+
+/* Tetrominos are small values: position, shape and rotation index. The
+ * blocks of each rotation are looked up in TETROMINO_TABLE, so copying or
+ * rotating a piece never allocates */
+struct Tetromino {
+    char x;
+    char y;
+    bool visible = true;
+
+    unsigned char shape = SHAPE_T;
+    unsigned char rotation = 0;
+};
+
+static_assert(std::is_trivially_copyable<Tetromino>::value, "Tetromino must stay a plain value");
+
+struct ShapeInfo {
+    unsigned char size;   // Width and height of the square shape grid
+    unsigned char color;  // Block value written to the field
+
+    // Row bitmasks of each rotation, bit c is column c of the shape grid
+    uint16_t rows[4][4];
+
+    // Lowest occupied row of each column per rotation, -1 for empty columns
+    signed char bottoms[4][4];
+};
+
+// Spawn orientation of every shape, in ShapeId order
+constexpr unsigned char TETROMINO_SHAPES[NUM_SHAPES][4][4] = {
+    {{0, 1, 0},
+     {1, 1, 1},
+     {0, 0, 0}},
+
+    {{2, 2},
+     {2, 2}},
+
+    {{0, 3, 3},
+     {3, 3, 0},
+     {0, 0, 0}},
+
+    {{4, 4, 0},
+     {0, 4, 4},
+     {0, 0, 0}},
+
+    {{5, 5, 5},
+     {0, 0, 5},
+     {0, 0, 0}},
+
+    {{0, 0, 6},
+     {6, 6, 6},
+     {0, 0, 0}},
+
+    {{0, 0, 0, 0},
+     {7, 7, 7, 7},
+     {0, 0, 0, 0},
+     {0, 0, 0, 0}}
+};
+
+constexpr unsigned char TETROMINO_SIZES[NUM_SHAPES] = {3, 2, 3, 3, 3, 3, 4};
+
+constexpr ShapeInfo makeShapeInfo(unsigned char shape){
+    /* Builds the row masks of all four rotations of a shape. Each
+     * rotation turns the previous one by 90 degrees clockwise */
+    ShapeInfo info = {TETROMINO_SIZES[shape], static_cast<unsigned char>(shape + 1), {}, {}};
+    unsigned char tSize = info.size;
+
+    for (unsigned char r = 0; r < tSize; r++)
+        for (unsigned char c = 0; c < tSize; c++)
+            if (TETROMINO_SHAPES[shape][r][c] != 0)
+                info.rows[0][r] |= 1u << c;
+
+    for (unsigned char rot = 1; rot < 4; rot++)
+        for (unsigned char r = 0; r < tSize; r++)
+            for (unsigned char c = 0; c < tSize; c++)
+                if (info.rows[rot - 1][tSize - 1 - c] & (1u << r))
+                    info.rows[rot][r] |= 1u << c;
+
+    for (unsigned char rot = 0; rot < 4; rot++)
+        for (unsigned char c = 0; c < 4; c++){
+            info.bottoms[rot][c] = -1;
+            for (unsigned char r = 0; r < tSize; r++)
+                if (info.rows[rot][r] & (1u << c))
+                    info.bottoms[rot][c] = r;
+        }
+
+    return info;
+}
+
+constexpr ShapeInfo TETROMINO_TABLE[NUM_SHAPES] = {
+    makeShapeInfo(SHAPE_T), makeShapeInfo(SHAPE_B), makeShapeInfo(SHAPE_S),
+    makeShapeInfo(SHAPE_Z), makeShapeInfo(SHAPE_L), makeShapeInfo(SHAPE_J),
+    makeShapeInfo(SHAPE_I)
+};
+
+inline unsigned char tetrominoSize(const Tetromino& tetromino){
+    return TETROMINO_TABLE[tetromino.shape].size;
+}
+
+inline unsigned char tetrominoColor(const Tetromino& tetromino){
+    return TETROMINO_TABLE[tetromino.shape].color;
+}
+
+inline const uint16_t* tetrominoRows(const Tetromino& tetromino){
+    return TETROMINO_TABLE[tetromino.shape].rows[tetromino.rotation];
+}
+
+inline const signed char* tetrominoBottoms(const Tetromino& tetromino){
+    return TETROMINO_TABLE[tetromino.shape].bottoms[tetromino.rotation];
+}
+
+inline bool tetrominoCell(const Tetromino& tetromino, unsigned char r, unsigned char c){
+    return (tetrominoRows(tetromino)[r] >> c) & 1u;
+}
+
+#endif
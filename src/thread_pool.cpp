@@ -0,0 +1,144 @@
+#include "thread_pool.h"
+
+#include <cstdio>
+
+#include "trace.h"
+
+static thread_local const WorkStealingPool* tPool = nullptr;
+static thread_local int tWorker = -1;
+
+WorkStealingPool::WorkStealingPool(unsigned int nThreads) : mPending(0), mQueued(0), mNextQueue(0), mStopping(false){
+    if (nThreads == 0)
+        nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0)
+        nThreads = 1;
+
+    for (unsigned int i = 0; i < nThreads; i++)
+        mQueues.emplace_back(new WorkerQueue());
+
+    for (unsigned int i = 0; i < nThreads; i++)
+        mWorkers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool(){
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+
+    for (std::thread& worker : mWorkers)
+        worker.join();
+}
+
+void WorkStealingPool::TaskRing::pushBack(std::function<void()>&& task){
+    if (mCount == mSlots.size()){
+        // Full, unroll the ring into a twice as large one
+        std::vector<std::function<void()>> slots(2 * mSlots.size());
+        for (size_t i = 0; i < mCount; i++)
+            slots[i] = std::move(mSlots[(mHead + i) % mSlots.size()]);
+        mSlots.swap(slots);
+        mHead = 0;
+    }
+
+    mSlots[(mHead + mCount) % mSlots.size()] = std::move(task);
+    mCount++;
+}
+
+void WorkStealingPool::TaskRing::popBack(std::function<void()>& task){
+    mCount--;
+    task = std::move(mSlots[(mHead + mCount) % mSlots.size()]);
+}
+
+void WorkStealingPool::TaskRing::popFront(std::function<void()>& task){
+    task = std::move(mSlots[mHead]);
+    mHead = (mHead + 1) % mSlots.size();
+    mCount--;
+}
+
+int WorkStealingPool::currentWorker() const{
+    return tPool == this ? tWorker : -1;
+}
+
+void WorkStealingPool::submit(std::function<void()> task){
+    // Keep work local when a task spawns more tasks, otherwise spread it round-robin
+    int worker = currentWorker();
+    unsigned int queue = worker >= 0 ? worker : mNextQueue++ % mQueues.size();
+
+    /* Counted before the task becomes visible so a fast worker can't
+     * finish it first, and under the wake mutex so a worker about to
+     * sleep can't miss it */
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mPending++;
+        mQueued++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mQueues[queue]->mutex);
+        mQueues[queue]->tasks.pushBack(std::move(task));
+    }
+    mWake.notify_one();
+}
+
+void WorkStealingPool::wait(){
+    /* Must not be called from inside a task, the calling worker would
+     * wait for itself */
+    std::unique_lock<std::mutex> lock(mWakeMutex);
+    mIdle.wait(lock, [this]{ return mPending == 0; });
+}
+
+bool WorkStealingPool::popTask(unsigned int worker, std::function<void()>& task){
+    // Newest task from our own queue first, it is most likely still in cache
+    {
+        WorkerQueue& own = *mQueues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()){
+            own.tasks.popBack(task);
+            mQueued--;
+            return true;
+        }
+    }
+
+    // Steal the oldest task of another worker
+    for (unsigned int i = 1; i < mQueues.size(); i++){
+        WorkerQueue& victim = *mQueues[(worker + i) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()){
+            victim.tasks.popFront(task);
+            mQueued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned int worker){
+    tPool = this;
+    tWorker = worker;
+#ifdef TETRIS_TRACE
+    char name[32];
+    std::snprintf(name, sizeof(name), "pool worker %u", worker);
+    traceThreadName(name);
+#endif
+
+    std::function<void()> task;
+    while (true){
+        if (popTask(worker, task)){
+            task();
+            task = nullptr;
+
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            if (--mPending == 0)
+                mIdle.notify_all();
+            continue;
+        }
+
+        // Nothing to run or steal, sleep until new work is queued
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWake.wait(lock, [this]{ return mStopping || mQueued > 0; });
+        if (mStopping && mQueued == 0)
+            return;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef TETRIS_THREAD_POOL_H
+#define TETRIS_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads, each with its own task deque. Workers take
+ * tasks from the back of their own deque and steal from the front of the
+ * others when they run dry, so uneven task lengths still keep every core
+ * busy. Tasks submitted from a worker go to that worker's deque */
+class WorkStealingPool {
+    public:
+        WorkStealingPool(unsigned int nThreads = 0);  // 0 uses all hardware threads
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        void submit(std::function<void()> task);
+        void wait();  // Blocks until every submitted task has finished
+
+        unsigned int size() const { return mWorkers.size(); }
+
+        // Index of the calling worker thread in this pool, or -1 outside the pool
+        int currentWorker() const;
+
+    private:
+        /* Double ended task queue on a ring of std::function slots. The
+         * ring only grows, so once it has seen the largest burst of tasks
+         * queueing never allocates again. Small tasks are stored inside the
+         * std::function itself, capture a pointer and an index rather than
+         * a lot of references to keep submit() allocation free */
+        class TaskRing {
+            public:
+                TaskRing(size_t capacity) : mSlots(capacity), mHead(0), mCount(0) {}
+
+                bool empty() const { return mCount == 0; }
+                void pushBack(std::function<void()>&& task);
+                void popBack(std::function<void()>& task);
+                void popFront(std::function<void()>& task);
+
+            private:
+                std::vector<std::function<void()>> mSlots;
+                size_t mHead;
+                size_t mCount;
+        };
+
+        static const size_t INITIAL_QUEUE_SIZE = 64;
+
+        struct WorkerQueue {
+            std::mutex mutex;
+            TaskRing tasks{INITIAL_QUEUE_SIZE};
+        };
+
+        std::vector<std::thread> mWorkers;
+        std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+
+        std::mutex mWakeMutex;
+        std::condition_variable mWake;
+        std::condition_variable mIdle;
+
+        std::atomic<unsigned int> mPending;  // Submitted but not finished
+        std::atomic<unsigned int> mQueued;   // Submitted but not started
+        std::atomic<unsigned int> mNextQueue;
+        bool mStopping;
+
+        bool popTask(unsigned int worker, std::function<void()>& task);
+        void workerLoop(unsigned int worker);
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "trace.h"
+
+#ifdef TETRIS_TRACE
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceRecord {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> end;
+};
+
+/* Written only by its own thread. count is the number of events ever
+ * recorded, event i lives in slot i % TRACE_CAPACITY */
+struct TraceBuffer {
+    unsigned int thread;
+    char name[32];
+    std::atomic<uint64_t> count;
+    TraceRecord records[TRACE_CAPACITY];
+};
+
+// Buffers outlive their threads, so events of finished threads are still written
+static std::mutex gTraceMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> gTraceBuffers;
+static const uint64_t gTraceStart = traceNow();
+
+static thread_local TraceBuffer* tTraceBuffer = NULL;
+
+static TraceBuffer* traceBuffer(){
+    // Recording only takes the lock the first time a thread records
+    if (tTraceBuffer == NULL){
+        // Not zeroed, records past count are never read and the pages are only touched once used
+        std::unique_ptr<TraceBuffer> buffer(new TraceBuffer);
+        buffer->count.store(0, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(gTraceMutex);
+        buffer->thread = static_cast<unsigned int>(gTraceBuffers.size());
+        std::snprintf(buffer->name, sizeof(buffer->name), "thread %u", buffer->thread);
+        tTraceBuffer = buffer.get();
+        gTraceBuffers.push_back(std::move(buffer));
+    }
+
+    return tTraceBuffer;
+}
+
+void traceEvent(const char* name, uint64_t start, uint64_t end){
+    TraceBuffer* buffer = traceBuffer();
+    uint64_t i = buffer->count.load(std::memory_order_relaxed);
+    TraceRecord& record = buffer->records[i % TRACE_CAPACITY];
+
+    /* As in a seqlock, writeTrace seeing any part of this event before its
+     * acquire fence means it then sees a count that rules out the event
+     * this slot held before */
+    std::atomic_thread_fence(std::memory_order_release);
+    record.name.store(name, std::memory_order_relaxed);
+    record.start.store(start, std::memory_order_relaxed);
+    record.end.store(end, std::memory_order_relaxed);
+    buffer->count.store(i + 1, std::memory_order_release);
+}
+
+void traceThreadName(const char* name){
+    TraceBuffer* buffer = traceBuffer();
+    std::lock_guard<std::mutex> lock(gTraceMutex);
+    std::snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+}
+
+static void writeJsonString(FILE* file, const char* text){
+    std::fputc('"', file);
+    for (; *text != '\0'; text++){
+        if (*text == '"' || *text == '\\')
+            std::fputc('\\', file);
+        if (static_cast<unsigned char>(*text) >= ' ')
+            std::fputc(*text, file);
+    }
+    std::fputc('"', file);
+}
+
+bool writeTrace(const char* path){
+    FILE* file = std::fopen(path, "wb");
+    if (file == NULL){
+        printf("Could not open %s for writing!\n", path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(gTraceMutex);
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (const std::unique_ptr<TraceBuffer>& buffer : gTraceBuffers){
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", buffer->thread);
+        writeJsonString(file, buffer->name);
+        std::fprintf(file, "}}");
+        first = false;
+
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        uint64_t begin = count > TRACE_CAPACITY ? count - TRACE_CAPACITY : 0;
+
+        // Copy first, so the events the thread overwrote meanwhile can be told apart
+        std::vector<TraceRecord> records(count - begin);
+        for (uint64_t i = begin; i < count; i++){
+            const TraceRecord& record = buffer->records[i % TRACE_CAPACITY];
+            records[i - begin].name.store(record.name.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            records[i - begin].start.store(record.start.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            records[i - begin].end.store(record.end.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t countAfter = buffer->count.load(std::memory_order_relaxed);
+
+        // The thread may have been writing event countAfter, which replaces event countAfter - TRACE_CAPACITY
+        uint64_t valid = countAfter >= TRACE_CAPACITY ? countAfter - TRACE_CAPACITY + 1 : 0;
+        for (uint64_t i = valid > begin ? valid : begin; i < count; i++){
+            const TraceRecord& record = records[i - begin];
+            uint64_t start = record.start.load(std::memory_order_relaxed);
+            uint64_t end = record.end.load(std::memory_order_relaxed);
+
+            // Chrome expects microseconds, fractions keep nanosecond precision
+            std::fprintf(file, ",\n{\"name\":");
+            writeJsonString(file, record.name.load(std::memory_order_relaxed));
+            std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    buffer->thread, (start - gTraceStart) / 1000.0, (end - start) / 1000.0);
+        }
+    }
+
+    std::fprintf(file, "\n]}\n");
+    bool ok = std::ferror(file) == 0;
+    if (std::fclose(file) != 0)
+        ok = false;
+    if (!ok)
+        printf("Could not write trace %s!\n", path);
+    return ok;
+}
+
+#endif
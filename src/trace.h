@@ -0,0 +1,59 @@
+#ifndef TETRIS_TRACE_H
+#define TETRIS_TRACE_H
+
+/* Scoped timers written out in Chrome's Trace Event format, for loading a
+ * session into chrome://tracing or Perfetto. TRACE_SCOPE("name") records
+ * one complete event from that line to the end of the enclosing block.
+ * Every thread records into a ring of its own without locking, so only
+ * the latest TRACE_CAPACITY events of each thread are kept.
+ *
+ * Tracing is only built with the TETRIS_TRACE option, otherwise the
+ * macros expand to nothing and none of this is compiled */
+
+#ifdef TETRIS_TRACE
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+const size_t TRACE_CAPACITY = 1 << 18;  // Events kept per thread
+
+inline uint64_t traceNow(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// name must stay valid until the trace is written, which string literals do
+void traceEvent(const char* name, uint64_t start, uint64_t end);
+
+// Shown for the calling thread in the viewer, the name is copied
+void traceThreadName(const char* name);
+
+/* Writes the events of every thread that recorded any. Threads may keep
+ * recording meanwhile, events they overwrite during the write are left out */
+bool writeTrace(const char* path);
+
+class TraceScope {
+    public:
+        explicit TraceScope(const char* name) : mName(name), mStart(traceNow()){}
+        ~TraceScope(){ traceEvent(mName, mStart, traceNow()); }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char* mName;
+        uint64_t mStart;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+
+#endif
+
+#endif
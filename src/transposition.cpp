@@ -0,0 +1,98 @@
+#include "transposition.h"
+
+#include "piece_generator.h"
+
+// Random keys drawn once from a fixed seed, the same in every run
+struct ZobristKeys {
+    uint64_t rows[FIELD_ROWS][2][32];  // Columns 0-4 and 5-9 of each row
+    uint64_t shapes[NUM_SHAPES][4];
+    uint64_t x[32];
+    uint64_t y[32];
+
+    ZobristKeys(){
+        uint64_t state = 0x5A0B81575EEDull;
+        for (auto& row : rows)
+            for (auto& group : row)
+                for (uint64_t& key : group)
+                    key = splitMix64(state);
+        for (auto& shape : shapes)
+            for (uint64_t& key : shape)
+                key = splitMix64(state);
+        for (uint64_t& key : x)
+            key = splitMix64(state);
+        for (uint64_t& key : y)
+            key = splitMix64(state);
+    }
+};
+
+static_assert(FIELD_COLS <= 10, "Zobrist keys cover two groups of 5 columns");
+
+static const ZobristKeys gZobrist;
+
+uint64_t zobristFieldKey(const Field& field){
+    uint64_t key = 0;
+    for (unsigned char r = 0; r < FIELD_ROWS; r++){
+        uint16_t row = field.rowMask(r);
+        key ^= gZobrist.rows[r][0][row & 31] ^ gZobrist.rows[r][1][row >> 5];
+    }
+
+    return key;
+}
+
+uint64_t zobristUpdateKey(uint64_t key, const Field& before, const Field& after, int first, int last){
+    if (first < 0)
+        first = 0;
+    if (last >= FIELD_ROWS)
+        last = FIELD_ROWS - 1;
+
+    for (int r = first; r <= last; r++){
+        uint16_t from = before.rowMask(r);
+        uint16_t to = after.rowMask(r);
+        key ^= gZobrist.rows[r][0][from & 31] ^ gZobrist.rows[r][1][from >> 5]
+            ^ gZobrist.rows[r][0][to & 31] ^ gZobrist.rows[r][1][to >> 5];
+    }
+
+    return key;
+}
+
+uint64_t zobristPieceKey(const Tetromino& tetromino){
+    return gZobrist.shapes[tetromino.shape][tetromino.rotation]
+        ^ gZobrist.x[tetromino.x & 31] ^ gZobrist.y[tetromino.y & 31];
+}
+
+TranspositionTable::TranspositionTable(unsigned int sizeLog2)
+        : mEntries(new Entry[1ull << sizeLog2]), mMask((1ull << sizeLog2) - 1), mHits(0), mMisses(0){
+    clear();
+}
+
+void TranspositionTable::clear(){
+    for (uint64_t i = 0; i <= mMask; i++){
+        mEntries[i].check.store(0, std::memory_order_relaxed);
+        mEntries[i].payload.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool TranspositionTable::probe(uint64_t key, uint64_t& payload) const{
+    /* An empty entry looks like key 0 with payload 0, keys are made odd so
+     * it never matches */
+    key |= 1;
+    const Entry& entry = mEntries[(key >> 1) & mMask];
+    uint64_t value = entry.payload.load(std::memory_order_relaxed);
+    if ((entry.check.load(std::memory_order_relaxed) ^ value) != key)
+        return false;
+
+    payload = value;
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, uint64_t payload){
+    key |= 1;
+    Entry& entry = mEntries[(key >> 1) & mMask];
+    entry.check.store(key ^ payload, std::memory_order_relaxed);
+    entry.payload.store(payload, std::memory_order_relaxed);
+}
+
+void TranspositionTable::addCounts(uint64_t hits, uint64_t misses){
+    mHits.fetch_add(hits, std::memory_order_relaxed);
+    mMisses.fetch_add(misses, std::memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+#ifndef TETRIS_TRANSPOSITION_H
+#define TETRIS_TRANSPOSITION_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "field.h"
+#include "tetromino.h"
+
+/* Zobrist keys of search states. The field key XORs one random key per
+ * row and group of 5 columns, the piece key one per shape, rotation and
+ * position, so the key of a field with a piece is fieldKey ^ pieceKey */
+uint64_t zobristFieldKey(const Field& field);
+uint64_t zobristPieceKey(const Tetromino& tetromino);
+
+// Key of after, which only differs from before (with key key) in rows first..last
+uint64_t zobristUpdateKey(uint64_t key, const Field& before, const Field& after, int first, int last);
+
+/* Fixed size hash table of 64-bit payloads, shared by all search threads
+ * without any locking. An entry stores key ^ payload next to the payload,
+ * a reader that races a writer sees a key that doesn't match and treats
+ * the entry as a miss, so a torn entry is never returned. Stores always
+ * replace what was in the slot */
+class TranspositionTable {
+    public:
+        explicit TranspositionTable(unsigned int sizeLog2);
+
+        TranspositionTable(const TranspositionTable&) = delete;
+        TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+        bool probe(uint64_t key, uint64_t& payload) const;
+        void store(uint64_t key, uint64_t payload);
+        void clear();
+
+        // Searches count lookups locally and add them here once per task
+        void addCounts(uint64_t hits, uint64_t misses);
+        uint64_t hits() const { return mHits.load(std::memory_order_relaxed); }
+        uint64_t misses() const { return mMisses.load(std::memory_order_relaxed); }
+
+    private:
+        struct Entry {
+            std::atomic<uint64_t> check;  // key ^ payload
+            std::atomic<uint64_t> payload;
+        };
+
+        std::unique_ptr<Entry[]> mEntries;
+        uint64_t mMask;
+
+        alignas(64) std::atomic<uint64_t> mHits;
+        std::atomic<uint64_t> mMisses;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TETRIS_TRIPLE_BUFFER_H
+#define TETRIS_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+/* Hands the latest value from exactly one writer thread to exactly one
+ * reader thread. The writer fills back() and publishes it by swapping it
+ * with the middle buffer, the reader swaps the middle buffer into front()
+ * when it holds something newer. Neither side ever waits, values the
+ * reader didn't get to are skipped */
+template <typename T>
+class TripleBuffer {
+    public:
+        TripleBuffer() : mMiddle(1), mBack(2), mFront(0) {}
+
+        TripleBuffer(const TripleBuffer&) = delete;
+        TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+        // Writer side
+        T& back() { return mBuffers[mBack]; }
+
+        void publish(){
+            mBack = mMiddle.exchange(mBack | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // Reader side. Returns false if nothing was published since the last update
+        bool update(){
+            if (!(mMiddle.load(std::memory_order_relaxed) & FRESH))
+                return false;
+
+            mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+
+        const T& front() const { return mBuffers[mFront]; }
+
+    private:
+        static const unsigned int INDEX = 3;
+        static const unsigned int FRESH = 4;  // Set while the middle buffer hasn't been read
+
+        T mBuffers[3];
+
+        // The writer and the reader each keep their own index on their own cache line
+        alignas(64) std::atomic<unsigned int> mMiddle;
+        alignas(64) unsigned int mBack;
+        alignas(64) unsigned int mFront;
+};
+
+#endif
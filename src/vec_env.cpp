@@ -0,0 +1,317 @@
+#include "vec_env.h"
+
+#include <cstring>
+
+#include "trace.h"
+
+#if defined(__SSE2__) && !defined(TETRIS_SCALAR_VEC_ENV)
+#include <emmintrin.h>
+#define TETRIS_SSE2_VEC_ENV
+#endif
+
+static const unsigned char FIELD_END = VEC_ENV_TOP_ROWS + FIELD_ROWS;  // First floor row
+
+static inline uint16_t shiftedRow(const uint16_t* pieceRows, unsigned char r, int x){
+    // x is at least -3 and at most 9, so every piece row lands inside the 16 bits
+    return static_cast<uint16_t>(pieceRows[r] << (x + VEC_ENV_WALL_BITS));
+}
+
+static inline uint32_t fullRows(const uint16_t* rows){
+    /* Bit r is set for every full field row r. The wall rows count as full
+     * too, they are masked off at the end */
+#ifdef TETRIS_SSE2_VEC_ENV
+    const __m128i cells = _mm_set1_epi16(static_cast<short>(VEC_ENV_CELLS));
+    uint32_t full = 0;
+    for (unsigned char r = 0; r < VEC_ENV_ROW_STRIDE; r += 16){
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(rows + r));
+        __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(rows + r + 8));
+        a = _mm_cmpeq_epi16(_mm_and_si128(a, cells), cells);
+        b = _mm_cmpeq_epi16(_mm_and_si128(b, cells), cells);
+        full |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(a, b))) << r;
+    }
+#else
+    uint32_t full = 0;
+    for (unsigned char r = 0; r < VEC_ENV_ROW_STRIDE; r++)
+        if ((rows[r] & VEC_ENV_CELLS) == VEC_ENV_CELLS)
+            full |= 1u << r;
+#endif
+    return (full >> VEC_ENV_TOP_ROWS) & ((1u << FIELD_ROWS) - 1);
+}
+
+// Bytes of 0 or 1 for the FIELD_COLS cells of every row, padded to 16 bytes
+struct CellBytes {
+    alignas(16) uint8_t rows[1 << FIELD_COLS][16];
+};
+
+constexpr CellBytes makeCellBytes(){
+    CellBytes table = {};
+    for (unsigned int mask = 0; mask < (1u << FIELD_COLS); mask++)
+        for (unsigned int c = 0; c < FIELD_COLS; c++)
+            table.rows[mask][c] = (mask >> c) & 1;
+    return table;
+}
+
+static constexpr CellBytes CELL_BYTES = makeCellBytes();
+
+static inline void writeCells(const uint16_t* rows, const uint16_t* active, uint8_t* cells){
+    /* 1 for every locked block and 2 for every block of the active piece.
+     * Every row is looked up whole, which measured faster than expanding
+     * the bits with arithmetic */
+    for (unsigned char r = 0; r < FIELD_ROWS; r++, cells += FIELD_COLS){
+        const uint8_t* locked = CELL_BYTES.rows[(rows[r] & VEC_ENV_CELLS) >> VEC_ENV_WALL_BITS];
+        const uint8_t* piece = CELL_BYTES.rows[(active[r] & VEC_ENV_CELLS) >> VEC_ENV_WALL_BITS];
+#ifdef TETRIS_SSE2_VEC_ENV
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(locked));
+        __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(piece));
+        __m128i bytes = _mm_add_epi8(a, _mm_add_epi8(b, b));
+
+        // The padding spills into the next row, which is written next. The last row must not spill
+        if (r + 1 < FIELD_ROWS)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(cells), bytes);
+        else{
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(cells), bytes);
+            uint16_t last = static_cast<uint16_t>(_mm_extract_epi16(bytes, 4));
+            std::memcpy(cells + 8, &last, sizeof(last));
+        }
+#else
+        for (unsigned char c = 0; c < FIELD_COLS; c++)
+            cells[c] = locked[c] + 2 * piece[c];
+#endif
+    }
+}
+
+VecEnv::VecEnv(const VecEnvConfig& config)
+        : mConfig(config), mChunkBody(NULL), mActions(NULL), mObservations(NULL), mRewards(NULL), mDones(NULL){
+    if (mConfig.envs == 0)
+        mConfig.envs = 1;
+
+    const unsigned int n = mConfig.envs;
+    mFields.reset(new FieldRows[n]);
+    mX.resize(n);
+    mY.resize(n);
+    mShapes.resize(n);
+    mRotations.resize(n);
+    mNext.resize(n);
+    mScores.resize(n);
+    mPlacedCounts.resize(n);
+    mTickTimers.resize(n);
+    mMaxTickTimes.resize(n);
+    mSeedStates.resize(n);
+    mEpisodeSeeds.resize(n);
+
+    // Every environment gets its own stream of episode seeds
+    uint64_t seedState = mConfig.seed;
+    mPieces.reserve(n);
+    for (unsigned int i = 0; i < n; i++){
+        mSeedStates[i] = splitMix64(seedState);
+        mPieces.emplace_back(0);
+    }
+
+    // A few chunks per worker, so workers that finish early steal the rest
+    if (mConfig.threads != 1)
+        mPool.reset(new WorkStealingPool(mConfig.threads));
+    unsigned int maxChunks = mPool ? mPool->size() * 4 : 1;
+    mChunks = (n + MIN_CHUNK_ENVS - 1) / MIN_CHUNK_ENVS;
+    if (mChunks > maxChunks)
+        mChunks = maxChunks;
+
+    for (unsigned int i = 0; i < n; i++)
+        startGame(i);
+}
+
+void VecEnv::reset(uint8_t* observations){
+    mObservations = observations;
+    runChunks(&VecEnv::resetRange);
+}
+
+void VecEnv::step(const uint8_t* actions, uint8_t* observations, float* rewards, uint8_t* dones){
+    TRACE_SCOPE("VecEnv::step");
+    mActions = actions;
+    mObservations = observations;
+    mRewards = rewards;
+    mDones = dones;
+    runChunks(&VecEnv::stepRange);
+}
+
+void VecEnv::runChunks(ChunkBody body){
+    if (mChunks <= 1){
+        (this->*body)(0, mConfig.envs);
+        return;
+    }
+
+    // Tasks only capture this and the chunk index, so submitting them never allocates
+    mChunkBody = body;
+    for (unsigned int c = 0; c < mChunks; c++)
+        mPool->submit([this, c](){
+            (this->*mChunkBody)(static_cast<uint64_t>(mConfig.envs) * c / mChunks,
+                    static_cast<uint64_t>(mConfig.envs) * (c + 1) / mChunks);
+        });
+    mPool->wait();
+}
+
+void VecEnv::resetRange(unsigned int first, unsigned int last){
+    for (unsigned int i = first; i < last; i++){
+        startGame(i);
+        if (mObservations != NULL)
+            observe(i, mObservations + static_cast<size_t>(i) * VEC_OBS_SIZE);
+    }
+}
+
+void VecEnv::stepRange(unsigned int first, unsigned int last){
+    /* Same order of events as GameState::step(): the action, then the
+     * gravity tick, which locks the piece when it can't move down */
+    for (unsigned int i = first; i < last; i++){
+        uint8_t action = mActions != NULL ? mActions[i] : static_cast<uint8_t>(VEC_NOOP);
+        bool forceTick = false;
+        int points = 0;
+        bool done = false;
+
+        switch (action){
+            case VEC_LEFT:
+            case VEC_RIGHT:{
+                int x = mX[i] + (action == VEC_LEFT ? -1 : 1);
+                if (!collides(i, x, mY[i], mRotations[i]))
+                    mX[i] = x;
+                break;
+            }
+            case VEC_DOWN:
+                moveDown(i);
+                break;
+            case VEC_ROTATE:{
+                // Right kick first, then left, like rotate()
+                unsigned char rotation = (mRotations[i] + 1) & 3;
+                int x = mX[i];
+                if (!collides(i, x, mY[i], rotation) || !collides(i, ++x, mY[i], rotation) || !collides(i, x -= 2, mY[i], rotation)){
+                    mX[i] = x;
+                    mRotations[i] = rotation;
+                }
+                break;
+            }
+            case VEC_DROP:
+                while (moveDown(i));
+                forceTick = true;
+                break;
+        }
+
+        mTickTimers[i] += mConfig.stepMs;
+        if (mTickTimers[i] > mMaxTickTimes[i] || forceTick){
+            mTickTimers[i] = 0;
+
+            if (!moveDown(i)){
+                points = endTurn(i);
+                if (points < 0){
+                    points = 0;
+                    done = true;
+                    startGame(i);
+                }
+                else{
+                    if (points > 0 && mMaxTickTimes[i] > 25)
+                        mMaxTickTimes[i] -= 10;
+                    mScores[i] += points;
+                }
+            }
+        }
+
+        if (mRewards != NULL)
+            mRewards[i] = static_cast<float>(points);
+        if (mDones != NULL)
+            mDones[i] = done;
+        if (mObservations != NULL)
+            observe(i, mObservations + static_cast<size_t>(i) * VEC_OBS_SIZE);
+    }
+}
+
+void VecEnv::observe(unsigned int env, uint8_t* observation) const{
+    // The active piece as rows of its own, so the cells are written without a branch per block
+    uint16_t active[VEC_ENV_ROW_STRIDE] = {};
+    const uint16_t* pieceRows = TETROMINO_TABLE[mShapes[env]].rows[mRotations[env]];
+    for (unsigned char r = 0; r < 4; r++)
+        active[VEC_ENV_TOP_ROWS + mY[env] + r] = shiftedRow(pieceRows, r, mX[env]);
+
+    writeCells(rows(env), active + VEC_ENV_TOP_ROWS, observation);
+    observation[VEC_OBS_CELLS] = mShapes[env];
+    observation[VEC_OBS_CELLS + 1] = mNext[env];
+}
+
+Tetromino VecEnv::activeTetromino(unsigned int env) const{
+    Tetromino tetromino;
+    tetromino.x = mX[env];
+    tetromino.y = mY[env];
+    tetromino.shape = mShapes[env];
+    tetromino.rotation = mRotations[env];
+    return tetromino;
+}
+
+void VecEnv::startGame(unsigned int i){
+    // Same start as GameState(episodeSeed), a new piece sequence every game
+    mEpisodeSeeds[i] = splitMix64(mSeedStates[i]);
+    mPieces[i].reseed(mEpisodeSeeds[i]);
+
+    uint16_t* rows = mFields[i].rows;
+    for (unsigned char r = 0; r < VEC_ENV_ROW_STRIDE; r++)
+        rows[r] = r >= VEC_ENV_TOP_ROWS && r < FIELD_END ? VEC_ENV_EMPTY_ROW : 0xFFFF;
+
+    mX[i] = FIELD_COLS / 2 - 1;
+    mY[i] = SPAWN_Y;
+    mShapes[i] = mPieces[i].next();
+    mRotations[i] = 0;
+    mNext[i] = mPieces[i].next();
+
+    mScores[i] = 0;
+    mPlacedCounts[i] = 0;
+    mTickTimers[i] = 0;
+    mMaxTickTimes[i] = START_TICK_TIME;
+}
+
+bool VecEnv::collides(unsigned int env, int x, int y, unsigned char rotation) const{
+    // Walls, floor and the rows above the field are filled, so this is just four ANDs
+    const uint16_t* pieceRows = TETROMINO_TABLE[mShapes[env]].rows[rotation];
+    const uint16_t* rows = mFields[env].rows + VEC_ENV_TOP_ROWS + y;
+    return ((rows[0] & shiftedRow(pieceRows, 0, x)) | (rows[1] & shiftedRow(pieceRows, 1, x))
+            | (rows[2] & shiftedRow(pieceRows, 2, x)) | (rows[3] & shiftedRow(pieceRows, 3, x))) != 0;
+}
+
+bool VecEnv::moveDown(unsigned int env){
+    if (collides(env, mX[env], mY[env] + 1, mRotations[env]))
+        return false;
+
+    mY[env]++;
+    return true;
+}
+
+int VecEnv::endTurn(unsigned int i){
+    /* Locks the piece, flushes full rows and spawns the next piece like
+     * GameState's endTurn. Returns the points scored, or -1 on game over */
+    uint16_t* rows = mFields[i].rows;
+    const uint16_t* pieceRows = TETROMINO_TABLE[mShapes[i]].rows[mRotations[i]];
+    for (unsigned char r = 0; r < 4; r++)
+        rows[VEC_ENV_TOP_ROWS + mY[i] + r] |= shiftedRow(pieceRows, r, mX[i]);
+    mPlacedCounts[i]++;
+
+    uint32_t full = fullRows(rows);
+    unsigned char nFlushed = __builtin_popcount(full);
+    if (full != 0){
+        // Bottom-up pass with a write cursor, the rows left at the top are emptied
+        int write = FIELD_END - 1;
+        for (int r = FIELD_END - 1; r >= VEC_ENV_TOP_ROWS; r--)
+            if (!(full & (1u << (r - VEC_ENV_TOP_ROWS))))
+                rows[write--] = rows[r];
+        for (; write >= VEC_ENV_TOP_ROWS; write--)
+            rows[write] = VEC_ENV_EMPTY_ROW;
+    }
+
+    // Topped out into the hidden rows
+    if (rows[VEC_ENV_TOP_ROWS + FIELD_HIDDEN_ROWS - 1] & VEC_ENV_CELLS)
+        return -1;
+
+    mX[i] = FIELD_COLS / 2 - 1;
+    mY[i] = SPAWN_Y;
+    mShapes[i] = mNext[i];
+    mRotations[i] = 0;
+    mNext[i] = mPieces[i].next();
+
+    if (collides(i, mX[i], mY[i], 0))
+        return -1;
+
+    return nFlushed * nFlushed * 100;
+}
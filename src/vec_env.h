@@ -0,0 +1,127 @@
+#ifndef TETRIS_VEC_ENV_H
+#define TETRIS_VEC_ENV_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "game.h"
+#include "piece_generator.h"
+#include "thread_pool.h"
+
+// One action per environment and step, each plays like a GameInput with that one field set
+enum VecAction : uint8_t {
+    VEC_NOOP, VEC_LEFT, VEC_RIGHT, VEC_DOWN, VEC_ROTATE, VEC_DROP, NUM_VEC_ACTIONS
+};
+
+/* Observation of one environment: FIELD_ROWS x FIELD_COLS cells, top row
+ * first, 0 for empty, 1 for a locked block and 2 for the active tetromino,
+ * followed by the shape of the active and of the next tetromino */
+const size_t VEC_OBS_CELLS = FIELD_ROWS * FIELD_COLS;
+const size_t VEC_OBS_SIZE = VEC_OBS_CELLS + 2;
+
+/* Every field is one cache line of 16-bit rows. Columns 0 to 9 are bits 3
+ * to 12, the bits to either side are walls, and the rows above and below
+ * the field are completely filled, so collisions need no bounds checks */
+const unsigned char VEC_ENV_ROW_STRIDE = 32;
+const unsigned char VEC_ENV_TOP_ROWS = 4;  // Wall rows above field row 0
+const unsigned char VEC_ENV_WALL_BITS = 3;
+const uint16_t VEC_ENV_CELLS = FULL_ROW << VEC_ENV_WALL_BITS;
+const uint16_t VEC_ENV_EMPTY_ROW = static_cast<uint16_t>(~VEC_ENV_CELLS);
+
+static_assert(FIELD_COLS + 2 * VEC_ENV_WALL_BITS == 16, "Walls fill the rest of a 16-bit row");
+static_assert(VEC_ENV_TOP_ROWS + FIELD_ROWS + 4 <= VEC_ENV_ROW_STRIDE, "Pieces can reach 4 rows below the field");
+
+struct VecEnvConfig {
+    unsigned int envs = 1024;
+    unsigned int threads = 0;  // 0 uses all hardware threads, 1 steps on the calling thread
+    uint64_t seed = 0;
+    uint32_t stepMs = 5;       // Game time per step, drives gravity like GameState::step()
+};
+
+/* Many games stepped in lockstep for reinforcement learning, with the same
+ * rules and scoring as GameState. State is kept as structure of arrays: all
+ * fields in one contiguous block, one cache line each, and the pieces,
+ * scores and timers in arrays of their own. A step applies one action to
+ * every game on the thread pool and writes the observations straight into
+ * the caller's buffer. Games that end restart right away with the next
+ * seed of their environment, their observation shows the new game.
+ *
+ * Episode seeds are drawn per environment, so a game can be replayed on a
+ * GameState created with episodeSeed() */
+class VecEnv {
+    public:
+        explicit VecEnv(const VecEnvConfig& config);
+
+        VecEnv(const VecEnv&) = delete;
+        VecEnv& operator=(const VecEnv&) = delete;
+
+        unsigned int size() const { return mConfig.envs; }
+
+        // Restarts every game and writes size() * VEC_OBS_SIZE bytes of observations
+        void reset(uint8_t* observations);
+
+        /* Applies actions[i] to game i. Rewards are the points scored, dones
+         * is 1 where a game ended and restarted. Any output may be NULL */
+        void step(const uint8_t* actions, uint8_t* observations, float* rewards, uint8_t* dones);
+
+        void observe(unsigned int env, uint8_t* observation) const;
+
+        // FIELD_ROWS rows of an environment, laid out as described for VEC_ENV_CELLS
+        const uint16_t* rows(unsigned int env) const { return mFields[env].rows + VEC_ENV_TOP_ROWS; }
+
+        Tetromino activeTetromino(unsigned int env) const;
+        const uint8_t* nextShapes() const { return mNext.data(); }
+        const uint32_t* scores() const { return mScores.data(); }
+        const uint32_t* placedCounts() const { return mPlacedCounts.data(); }
+        uint64_t episodeSeed(unsigned int env) const { return mEpisodeSeeds[env]; }
+
+    private:
+        struct alignas(64) FieldRows {
+            uint16_t rows[VEC_ENV_ROW_STRIDE];
+        };
+
+        static const unsigned int MIN_CHUNK_ENVS = 64;
+
+        typedef void (VecEnv::*ChunkBody)(unsigned int first, unsigned int last);
+
+        VecEnvConfig mConfig;
+        std::unique_ptr<FieldRows[]> mFields;
+
+        std::vector<int8_t> mX;
+        std::vector<int8_t> mY;
+        std::vector<uint8_t> mShapes;
+        std::vector<uint8_t> mRotations;
+        std::vector<uint8_t> mNext;
+
+        std::vector<uint32_t> mScores;
+        std::vector<uint32_t> mPlacedCounts;
+        std::vector<uint32_t> mTickTimers;
+        std::vector<uint32_t> mMaxTickTimes;
+
+        std::vector<uint64_t> mSeedStates;
+        std::vector<uint64_t> mEpisodeSeeds;
+        std::vector<PieceGenerator> mPieces;
+
+        std::unique_ptr<WorkStealingPool> mPool;
+        unsigned int mChunks;
+
+        // Arguments of the running step, read by the chunk tasks
+        ChunkBody mChunkBody;
+        const uint8_t* mActions;
+        uint8_t* mObservations;
+        float* mRewards;
+        uint8_t* mDones;
+
+        void runChunks(ChunkBody body);
+        void stepRange(unsigned int first, unsigned int last);
+        void resetRange(unsigned int first, unsigned int last);
+
+        void startGame(unsigned int env);
+        bool collides(unsigned int env, int x, int y, unsigned char rotation) const;
+        bool moveDown(unsigned int env);
+        int endTurn(unsigned int env);
+};
+
+#endif
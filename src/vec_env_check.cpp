@@ -0,0 +1,153 @@
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include <cstdlib>
+
+#include "game.h"
+#include "vec_env.h"
+
+/* Plays random actions on a VecEnv and on one GameState per environment,
+ * created from its episode seed, and checks after every step that both
+ * agree on the done flags, rewards, fields, pieces, scores and
+ * observations. Games that end are followed onto the next episode seed.
+ *
+ * Usage: vec-env-check [steps] [threads] [seed] */
+
+const unsigned int CHECK_ENVS = 500;
+const unsigned int MAX_REPORTED = 5;
+const uint8_t OBS_GUARD = 0xAB;  // Byte after the observations, must survive every step
+
+GameInput toGameInput(uint8_t action){
+    GameInput input;
+    if (action == VEC_LEFT)
+        input.direction = DIR_LEFT;
+    else if (action == VEC_RIGHT)
+        input.direction = DIR_RIGHT;
+    else if (action == VEC_DOWN)
+        input.direction = DIR_DOWN;
+
+    input.rotate = action == VEC_ROTATE;
+    input.drop = action == VEC_DROP;
+    return input;
+}
+
+uint8_t expectedCell(const GameState& game, int r, int c){
+    if (game.field().get(r, c))
+        return 1;
+
+    const Tetromino& active = game.activeTetromino();
+    if (r >= active.y && r < active.y + 4 && c >= active.x && c < active.x + 4
+            && tetrominoCell(active, r - active.y, c - active.x))
+        return 2;
+    return 0;
+}
+
+// Empty when env matches game, otherwise what differs first
+const char* compareEnv(const VecEnv& env, unsigned int i, const GameState& game, const uint8_t* observation){
+    const uint16_t* rows = env.rows(i);
+    for (int r = 0; r < FIELD_ROWS; r++)
+        if (((rows[r] & VEC_ENV_CELLS) >> VEC_ENV_WALL_BITS) != game.field().rowMask(r))
+            return "field";
+
+    Tetromino active = env.activeTetromino(i);
+    const Tetromino& expected = game.activeTetromino();
+    if (active.x != expected.x || active.y != expected.y || active.shape != expected.shape
+            || active.rotation != expected.rotation)
+        return "active tetromino";
+
+    if (env.scores()[i] != game.score() || env.placedCounts()[i] != game.placedCount())
+        return "score";
+    if (env.nextShapes()[i] != game.nextTetromino().shape)
+        return "next tetromino";
+
+    for (int r = 0; r < FIELD_ROWS; r++)
+        for (int c = 0; c < FIELD_COLS; c++)
+            if (observation[r * FIELD_COLS + c] != expectedCell(game, r, c))
+                return "observation";
+    if (observation[VEC_OBS_CELLS] != expected.shape || observation[VEC_OBS_CELLS + 1] != game.nextTetromino().shape)
+        return "observed shapes";
+
+    return "";
+}
+
+bool checkVecEnv(unsigned int nSteps, unsigned int nThreads, uint64_t seed){
+    VecEnvConfig config;
+    config.envs = CHECK_ENVS;
+    config.threads = nThreads;
+    config.seed = seed;
+    VecEnv env(config);
+
+    std::vector<uint8_t> observations(config.envs * VEC_OBS_SIZE + 1, OBS_GUARD);
+    std::vector<uint8_t> actions(config.envs);
+    std::vector<uint8_t> dones(config.envs);
+    std::vector<float> rewards(config.envs);
+
+    env.reset(observations.data());
+    std::vector<std::unique_ptr<GameState>> games(config.envs);
+    for (unsigned int i = 0; i < config.envs; i++)
+        games[i].reset(new GameState(env.episodeSeed(i)));
+
+    // Every action about as often, plus extra drops so games end and restart
+    std::mt19937 policy(static_cast<std::mt19937::result_type>(seed));
+    unsigned long long ended = 0;
+    unsigned long long mismatches = 0;
+
+    for (unsigned int s = 0; s < nSteps; s++){
+        for (uint8_t& action : actions){
+            unsigned int r = policy() % 20;
+            if (r >= NUM_VEC_ACTIONS)
+                r = r < 8 ? VEC_DROP : VEC_NOOP;
+            action = static_cast<uint8_t>(r);
+        }
+
+        env.step(actions.data(), observations.data(), rewards.data(), dones.data());
+        if (observations.back() != OBS_GUARD){
+            std::cout << "  Observations written past the end\n";
+            return false;
+        }
+
+        for (unsigned int i = 0; i < config.envs; i++){
+            GameState& game = *games[i];
+            uint32_t scoreBefore = game.score();
+            StepResult result = game.step(toGameInput(actions[i]), config.stepMs);
+
+            const char* mismatch = "";
+            if (result.gameOver != (dones[i] != 0))
+                mismatch = "done flag";
+            else if (result.gameOver){
+                ended++;
+                games[i].reset(new GameState(env.episodeSeed(i)));
+                mismatch = compareEnv(env, i, *games[i], observations.data() + i * VEC_OBS_SIZE);
+            }
+            else if (rewards[i] != static_cast<float>(game.score() - scoreBefore))
+                mismatch = "reward";
+            else
+                mismatch = compareEnv(env, i, game, observations.data() + i * VEC_OBS_SIZE);
+
+            if (*mismatch != '\0' && mismatches++ < MAX_REPORTED)
+                std::cout << "  Env " << i << " step " << s << ": " << mismatch << " differs\n";
+        }
+    }
+
+    std::cout << "  " << env.size() << " envs, " << nSteps << " steps, " << ended << " games ended, "
+              << mismatches << " mismatches\n";
+    return mismatches == 0;
+}
+
+int main(int argc, char* args[]){
+    unsigned int nSteps = argc > 1 ? std::atoi(args[1]) : 20000;
+    unsigned int nThreads = argc > 2 ? std::atoi(args[2]) : 0;
+    uint64_t seed = argc > 3 ? std::strtoull(args[3], NULL, 10) : 1;
+
+    bool ok = true;
+
+    std::cout << "Calling thread:\n";
+    ok = checkVecEnv(nSteps, 1, seed) && ok;
+
+    std::cout << "Thread pool:\n";
+    ok = checkVecEnv(nSteps, nThreads, seed) && ok;
+
+    std::cout << (ok ? "OK" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+#include "versus.h"
+
+#include <cstdio>
+
+#include "ai.h"
+#include "piece_generator.h"
+#include "spsc_ring.h"
+#include "trace.h"
+#include "triple_buffer.h"
+
+const size_t GARBAGE_QUEUE_SIZE = 64;      // Attacks in flight from one board to another
+const unsigned int MAX_PENDING_ATTACKS = 32;
+const uint32_t MAX_CATCH_UP_STEPS = 25;
+const unsigned int VERSUS_CACHE_SIZE_LOG2 = 14;
+
+unsigned char garbageForLines(unsigned char lines){
+    static const unsigned char rows[5] = {0, 0, 1, 2, 4};
+    return lines < 5 ? rows[lines] : 4;
+}
+
+struct VersusMatch::Board {
+    GameState game;
+
+    InputDecoder decoder;
+    InputQueue input;
+    std::unique_ptr<Bot> bot;
+    std::unique_ptr<Autopilot> autopilot;
+    uint32_t botTimer;
+
+    // One queue per sender, each only ever pushed to by that board's thread
+    SpscRing<GarbageAttack, GARBAGE_QUEUE_SIZE> incoming[MAX_VERSUS_BOARDS];
+
+    // Received attacks not added yet, oldest first
+    GarbageAttack pending[MAX_PENDING_ATTACKS];
+    unsigned int pendingHead;
+    unsigned int pendingCount;
+    unsigned int pendingRows;
+
+    uint64_t holeState;  // Picks the empty column of the garbage this board sends
+    uint32_t linesSent;
+    std::atomic<bool> alive;
+
+    TripleBuffer<BoardView> view;
+
+    Board(uint64_t seed, const InputTiming& timing)
+        : game(seed), decoder(timing), botTimer(0), pendingHead(0), pendingCount(0), pendingRows(0),
+          holeState(seed ^ 0x6A09E667F3BCC908ull), linesSent(0), alive(true){
+    }
+
+    void receive(const GarbageAttack& attack){
+        /* A full backlog tops out the board long before it runs out of
+         * entries. Rows the capped entry drops are not counted as pending */
+        if (pendingCount == MAX_PENDING_ATTACKS){
+            GarbageAttack& last = pending[(pendingHead + pendingCount - 1) % MAX_PENDING_ATTACKS];
+            unsigned int before = last.rows;
+            unsigned int rows = before + attack.rows;
+            last.rows = rows < FIELD_ROWS ? rows : FIELD_ROWS;
+            pendingRows += last.rows - before;
+        }
+        else{
+            pending[(pendingHead + pendingCount++) % MAX_PENDING_ATTACKS] = attack;
+            pendingRows += attack.rows;
+        }
+    }
+
+    unsigned char cancel(unsigned char rows){
+        // Cancels received rows, oldest first. Returns the rows left to send
+        while (rows > 0 && pendingCount > 0){
+            GarbageAttack& attack = pending[pendingHead];
+            unsigned char cancelled = rows < attack.rows ? rows : attack.rows;
+            attack.rows -= cancelled;
+            pendingRows -= cancelled;
+            rows -= cancelled;
+            if (attack.rows == 0){
+                pendingHead = (pendingHead + 1) % MAX_PENDING_ATTACKS;
+                pendingCount--;
+            }
+        }
+
+        return rows;
+    }
+
+    void addPending(){
+        for (; pendingCount > 0; pendingCount--){
+            const GarbageAttack& attack = pending[pendingHead];
+            game.addGarbage(attack.rows, attack.hole, GARBAGE_COLOR);
+            pendingHead = (pendingHead + 1) % MAX_PENDING_ATTACKS;
+        }
+        pendingRows = 0;
+    }
+};
+
+static uint64_t steadyMicros(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+VersusMatch::VersusMatch(const VersusConfig& config)
+        : mConfig(config), mStartTime(0), mStopping(false), mAlive(0), mOver(false){
+    if (mConfig.boards < MIN_VERSUS_BOARDS)
+        mConfig.boards = MIN_VERSUS_BOARDS;
+    if (mConfig.boards > MAX_VERSUS_BOARDS)
+        mConfig.boards = MAX_VERSUS_BOARDS;
+    if (mConfig.humans > mConfig.boards)
+        mConfig.humans = mConfig.boards;
+    if (mConfig.stepMs == 0)
+        mConfig.stepMs = 1;
+
+    // Bots search on their board's thread, a pool per board would only compete for the cores
+    BotConfig botConfig;
+    botConfig.threads = 1;
+    botConfig.cacheSizeLog2 = VERSUS_CACHE_SIZE_LOG2;
+
+    uint64_t seedState = mConfig.seed;
+    for (unsigned int b = 0; b < mConfig.boards; b++){
+        mBoards[b].reset(new Board(splitMix64(seedState), mConfig.timing));
+        if (!isHuman(b)){
+            mBoards[b]->bot.reset(new Bot(botConfig));
+            mBoards[b]->autopilot.reset(new Autopilot(*mBoards[b]->bot, mConfig.botBudget));
+        }
+        publishView(*mBoards[b]);
+    }
+    mAlive = mConfig.boards;
+}
+
+VersusMatch::~VersusMatch(){
+    stop();
+}
+
+uint64_t VersusMatch::now() const{
+    return mConfig.clock != NULL ? mConfig.clock() : steadyMicros();
+}
+
+void VersusMatch::start(){
+    stop();
+
+    mStopping = false;
+    mStartTime = now();
+    for (unsigned int b = 0; b < mConfig.boards; b++)
+        mThreads[b] = std::thread(&VersusMatch::run, this, b);
+}
+
+void VersusMatch::stop(){
+    mStopping = true;
+    for (unsigned int b = 0; b < mConfig.boards; b++)
+        if (mThreads[b].joinable())
+            mThreads[b].join();
+}
+
+InputQueue& VersusMatch::input(unsigned int board){
+    return mBoards[board]->input;
+}
+
+bool VersusMatch::updateView(unsigned int board){
+    return mBoards[board]->view.update();
+}
+
+const BoardView& VersusMatch::view(unsigned int board) const{
+    return mBoards[board]->view.front();
+}
+
+int VersusMatch::winner() const{
+    if (!isOver())
+        return -1;
+
+    for (unsigned int b = 0; b < mConfig.boards; b++)
+        if (mBoards[b]->alive.load(std::memory_order_acquire))
+            return b;
+    return -1;
+}
+
+void VersusMatch::run(unsigned int b){
+#ifdef TETRIS_TRACE
+    char name[32];
+    std::snprintf(name, sizeof(name), "versus board %u", b);
+    traceThreadName(name);
+#endif
+
+    /* Same fixed steps as the single player loop. Each step takes the
+     * input events captured up to its own end time */
+    const uint64_t stepMicros = mConfig.stepMs * 1000ull;
+    uint64_t simTime = mStartTime;
+
+    while (!mStopping.load(std::memory_order_relaxed)){
+        uint64_t time = now();
+        if (time - simTime > MAX_CATCH_UP_STEPS * stepMicros)
+            simTime = time - MAX_CATCH_UP_STEPS * stepMicros;
+
+        bool changed = false;
+        while (time - simTime >= stepMicros){
+            simTime += stepMicros;
+            changed |= stepBoard(b, simTime);
+        }
+        if (changed)
+            publishView(*mBoards[b]);
+
+        // Sleep until the next step is due
+        time = now();
+        if (simTime + stepMicros > time)
+            std::this_thread::sleep_for(std::chrono::microseconds(simTime + stepMicros - time));
+    }
+}
+
+bool VersusMatch::stepBoard(unsigned int b, uint64_t stepEnd){
+    /* Runs one logic step of a board. Returns true if anything that is
+     * drawn may have changed */
+    TRACE_SCOPE("versus step");
+    Board& board = *mBoards[b];
+
+    // Always consumed, so the queue doesn't back up once the board is out
+    GameInput input = board.decoder.step(board.input, stepEnd);
+    if (board.game.isGameOver() || isOver())
+        return false;
+
+    bool received = false;
+    GarbageAttack attack;
+    for (unsigned int o = 0; o < mConfig.boards; o++)
+        while (board.incoming[o].pop(attack)){
+            board.receive(attack);
+            received = true;
+        }
+
+    if (board.autopilot){
+        input = GameInput();
+        board.botTimer += mConfig.stepMs;
+        if (board.botTimer >= mConfig.botActionMs){
+            board.botTimer = 0;
+            input = board.autopilot->nextInput(board.game);
+        }
+    }
+
+    uint32_t revision = board.game.field().revision();
+    Tetromino active = board.game.activeTetromino();
+
+    StepResult result = board.game.step(input, mConfig.stepMs);
+    if (result.locked){
+        unsigned char rows = board.cancel(garbageForLines(result.linesCleared));
+        if (rows > 0)
+            sendGarbage(b, rows);
+        if (result.linesCleared == 0)
+            board.addPending();
+    }
+
+    if (board.game.isGameOver()){
+        board.alive.store(false, std::memory_order_release);
+        if (mAlive.fetch_sub(1, std::memory_order_acq_rel) <= 2)
+            mOver.store(true, std::memory_order_release);
+        return true;
+    }
+
+    const Tetromino& moved = board.game.activeTetromino();
+    return received || result.locked || revision != board.game.field().revision()
+        || moved.x != active.x || moved.y != active.y || moved.rotation != active.rotation;
+}
+
+void VersusMatch::sendGarbage(unsigned int b, unsigned char rows){
+    Board& board = *mBoards[b];
+    GarbageAttack attack = {rows, static_cast<unsigned char>(splitMix64(board.holeState) % FIELD_COLS)};
+    board.linesSent += rows;
+
+    // Attacks that don't fit are dropped, a board 64 attacks behind has lost anyway
+    for (unsigned int o = 0; o < mConfig.boards; o++)
+        if (o != b && mBoards[o]->alive.load(std::memory_order_relaxed))
+            mBoards[o]->incoming[b].push(attack);
+}
+
+void VersusMatch::publishView(Board& board){
+    const GameState& game = board.game;
+    BoardView& view = board.view.back();
+
+    for (unsigned char r = 0; r < FIELD_ROWS; r++)
+        for (unsigned char c = 0; c < FIELD_COLS; c++)
+            view.colors[r][c] = game.field().get(r, c);
+
+    // The ghost is found here so the render thread never looks at a field
+    view.active = game.activeTetromino();
+    view.landingRow = view.active.visible ? dropRow(view.active, game.field()) : view.active.y;
+    view.nextShape = game.nextTetromino().shape;
+    view.score = game.score();
+    view.linesSent = board.linesSent;
+    view.pendingGarbage = board.pendingRows;
+    view.gameOver = game.isGameOver();
+
+    board.view.publish();
+}
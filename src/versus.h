@@ -0,0 +1,106 @@
+#ifndef TETRIS_VERSUS_H
+#define TETRIS_VERSUS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "game.h"
+#include "input.h"
+
+const unsigned int MIN_VERSUS_BOARDS = 2;
+const unsigned int MAX_VERSUS_BOARDS = 8;
+const unsigned char GARBAGE_COLOR = 8;  // Block value of garbage rows
+
+// Garbage rows sent for clearing 0 to 4 lines with one piece
+unsigned char garbageForLines(unsigned char lines);
+
+// Rows one board sends to another, every row has the same empty column
+struct GarbageAttack {
+    unsigned char rows;
+    unsigned char hole;
+};
+
+// Everything drawn for one board, published by its thread whenever it changes
+struct BoardView {
+    unsigned char colors[FIELD_ROWS][FIELD_COLS];
+    Tetromino active;
+    char landingRow;  // Ghost row of the active tetromino
+    unsigned char nextShape;
+    uint32_t score;
+    uint32_t linesSent;
+    unsigned int pendingGarbage;  // Rows received but not added to the field yet
+    bool gameOver;
+};
+
+struct VersusConfig {
+    unsigned int boards = 2;
+    unsigned int humans = 1;    // Boards 0 to humans-1 play from their input queue, the others are bots
+    uint64_t seed = 0;
+    uint32_t stepMs = 5;
+    InputTiming timing;
+
+    uint32_t botActionMs = 60;  // Bots make one move this often
+    std::chrono::microseconds botBudget = std::chrono::milliseconds(5);
+
+    // Microseconds, in the same time base as the input event timestamps. NULL uses the steady clock
+    uint64_t (*clock)() = NULL;
+};
+
+/* 2 to 8 games played against each other. Every board runs its own fixed
+ * step simulation on its own thread, paced by the clock, so boards never
+ * wait for each other or for rendering. Line clears send garbage rows to
+ * every other board still playing through a lock-free queue per pair of
+ * boards. Received garbage first cancels the rows a board sends, the rest
+ * is added to the field when a piece locks without clearing a line. The
+ * last board left wins */
+class VersusMatch {
+    public:
+        explicit VersusMatch(const VersusConfig& config);
+        ~VersusMatch();
+
+        VersusMatch(const VersusMatch&) = delete;
+        VersusMatch& operator=(const VersusMatch&) = delete;
+
+        void start();
+        void stop();
+
+        unsigned int boards() const { return mConfig.boards; }
+        bool isHuman(unsigned int board) const { return board < mConfig.humans; }
+
+        // Events for a human board, pushed from a single thread
+        InputQueue& input(unsigned int board);
+
+        /* Reader side of the board views, for a single thread. updateView()
+         * returns false when the board hasn't changed since the last call,
+         * view() stays valid until the next updateView() of the board */
+        bool updateView(unsigned int board);
+        const BoardView& view(unsigned int board) const;
+
+        bool isOver() const { return mOver.load(std::memory_order_acquire); }
+
+        // Board left standing once the match is over, -1 before or if nobody is
+        int winner() const;
+
+    private:
+        struct Board;
+
+        VersusConfig mConfig;
+        std::unique_ptr<Board> mBoards[MAX_VERSUS_BOARDS];
+        std::thread mThreads[MAX_VERSUS_BOARDS];
+
+        uint64_t mStartTime;
+        std::atomic<bool> mStopping;
+        std::atomic<unsigned int> mAlive;
+        std::atomic<bool> mOver;
+
+        uint64_t now() const;
+        void run(unsigned int board);
+        bool stepBoard(unsigned int board, uint64_t stepEnd);
+        void sendGarbage(unsigned int board, unsigned char rows);
+        void publishView(Board& board);
+};
+
+#endif